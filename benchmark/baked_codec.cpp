@@ -0,0 +1,100 @@
+/*
+   Baked codec benchmark: the runtime configured message layout against the generated one
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: baked_codec_benchmark [frames]
+
+   Encodes and decodes the door, turn signal, speed and diagnostic messages with the layout
+   codegen wrote from the configuration at build time (SIMULATOR_LAYOUT_CONFIG). The runtime
+   path is what the controller and console do by default, a FrameEncoder per message and a
+   DecodePlan compiled from the layout read at startup. The baked path copies the same frame
+   template and stores and loads the signals through the generated constexpr fields. Both
+   must agree, frames per second of each are reported.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <linux/can.h>
+
+#include "../common/can.hpp"
+#include "../common/DecodePlan.hpp"
+#include "../common/FrameEncoder.hpp"
+#include "../common/SimulationConfig.hpp"
+#include "../common/VehicleMessage.hpp"
+#include "BakedLayout.hpp"
+
+static unsigned long long checksum;
+
+template <typename Function>
+static double measure(size_t count, Function run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+	run(i);
+    }
+    return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// one message both ways, mask keeps the values inside the signal
+template <typename Message>
+static bool run(const char *name, size_t count, const SimulationConfig& config, const MessageLayout& layout, VehicleSignal kind,
+		unsigned long long mask)
+{
+    DbcMessage message = vehicleMessage(layout, kind);
+    const DbcSignal& signal = message.signals[0];
+    FrameEncoder encoder(Message::frame_id, CAN_MAX_DLEN, Message::fd, config.messages.brs, config.messages.esi);
+    encoder.addField(signal.start_bit / 8, signal.length / 8, signal.big_endian);
+    DecodePlan plan(message);
+
+    canfd_frame frame;
+    for (unsigned long long value : { 0ULL, 1ULL, 0x5aULL, 0x1234ULL, mask })
+    {
+	long long runtime = -1;
+	encoder.encode(frame, { value & mask });
+	plan.decodeRaw(frame.data, frame.len, &runtime);
+
+	encoder.copy(frame);
+	Message::Value::encode(frame.data, value & mask);
+	if (runtime != Message::Value::decode(frame.data) || (unsigned long long)runtime != (value & mask))
+	{
+	    std::cerr << "Error: the baked " << name << " layout disagrees with the runtime one" << std::endl;
+	    return false;
+	}
+    }
+
+    double runtime = measure(count, [&](size_t i) {
+	long long value;
+	encoder.encode(frame, { i & mask });
+	asm volatile("" : : "r"(&frame) : "memory");
+	plan.decodeRaw(frame.data, frame.len, &value);
+	checksum += value;
+    });
+    double baked = measure(count, [&](size_t i) {
+	encoder.copy(frame);
+	Message::Value::encode(frame.data, i & mask);
+	asm volatile("" : : "r"(&frame) : "memory");
+	if (frame.len >= Message::Value::needed)
+	    checksum += Message::Value::decode(frame.data);
+    });
+    std::cout << name << "\t" << (unsigned long long)runtime << "\t" << (unsigned long long)baked << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+    // the runtime path reads the same layout, from the configuration it is built from
+    SimulationConfig config = BakedLayout::apply(SimulationConfig());
+
+    std::cout << "frames: " << count << std::endl;
+    std::cout << "message\t\truntime fps\tbaked fps" << std::endl;
+    bool agree = run<BakedLayout::Door>("door\t", count, config, config.messages.door, VehicleSignal::Door, 0xff) &&
+	run<BakedLayout::Signal>("signal\t", count, config, config.messages.signal, VehicleSignal::TurnSignal, 0xff) &&
+	run<BakedLayout::Speed>("speed\t", count, config, config.messages.speed, VehicleSignal::Speed, 0xffff) &&
+	run<BakedLayout::Diagnostic>("diagnostic", count, config, config.messages.diagnostic, VehicleSignal::Diagnostic, ~0ULL);
+    std::cout << "checksum " << checksum << std::endl;
+    return agree ? 0 : 1;
+}
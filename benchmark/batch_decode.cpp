@@ -0,0 +1,137 @@
+/*
+   Batch decoding benchmark: frame by frame decode plans against columnar batch decoding
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: batch_decode_benchmark [frames]
+
+   Decodes frames of one 64 byte CAN FD message with 50 signals of 1 to 16 bits (mixed
+   byte order and signedness) in batches of 4096, frame by frame through a DecodePlan and
+   column by column through a BatchDecoder with scalar code and, if the CPU has it, AVX2.
+   Reports signals decoded per second for each.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <linux/can.h>
+
+#include "../common/BatchDecoder.hpp"
+#include "../common/DecodePlan.hpp"
+
+static const int signal_count = 50;
+static const size_t batch_size = 4096;
+
+static DbcMessage build_message()
+{
+    std::minstd_rand random(1);
+    DbcMessage message;
+    message.id = 0x400;
+    message.name = "Benchmark";
+    message.length = 64;
+
+    // signals follow each other, Motorola ones counted from the most significant bit of byte 0
+    int bit = 0;
+    for (int i = 0; i < signal_count; ++i)
+    {
+	DbcSignal signal;
+	signal.name = "signal" + std::to_string(i);
+	signal.length = 1 + random() % 16;
+	signal.big_endian = i % 2;
+	signal.is_signed = i % 3 == 0;
+	signal.factor = 0.5;
+	signal.offset = -10;
+	signal.minimum = 0;
+	signal.maximum = 0;
+	signal.multiplexing = DbcSignal::Plain;
+	signal.mux_value = 0;
+	if (bit + signal.length > 8 * message.length)
+	    break;
+	signal.start_bit = signal.big_endian ? bit / 8 * 8 + 7 - bit % 8 : bit;
+	message.signals.push_back(signal);
+	bit += signal.length;
+    }
+    return message;
+}
+
+template <typename Function>
+static double measure(size_t batches, Function decode)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < batches; ++i)
+    {
+	decode();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    size_t batches = (count + batch_size - 1) / batch_size;
+    DbcMessage message = build_message();
+    size_t signals = message.signals.size();
+
+    std::minstd_rand random(2);
+    std::vector<canfd_frame> frames(batch_size);
+    for (canfd_frame& frame : frames)
+    {
+	memset(&frame, 0, sizeof(frame));
+	frame.can_id = message.id;
+	frame.len = message.length;
+	frame.flags = CANFD_FDF;
+	for (int i = 0; i < message.length; ++i)
+	    frame.data[i] = random();
+    }
+
+    // frame by frame, scattered into the same column layout
+    DecodePlan plan(message);
+    std::vector<double> rows(signals);
+    std::vector<double> columns(signals * batch_size);
+    double row_seconds = measure(batches, [&]() {
+	for (size_t row = 0; row < batch_size; ++row)
+	{
+	    plan.decode(frames[row].data, frames[row].len, rows.data());
+	    for (size_t signal = 0; signal < signals; ++signal)
+		columns[signal * batch_size + row] = rows[signal];
+	}
+	asm volatile("" : : "r"(columns.data()) : "memory");
+    });
+
+    double total = (double)batches * batch_size * signals;
+    std::cout << "signals: " << signals << ", frames: " << batches * batch_size << std::endl;
+    std::cout << "decoder\t\t\tsignals/s\tns/frame" << std::endl;
+    std::cout << "decode plan per frame\t" << (unsigned long long)(total / row_seconds) << "\t"
+	      << row_seconds * 1e9 / (batches * batch_size) << std::endl;
+
+    for (bool vectorized : { false, true })
+    {
+	BatchDecoder decoder(message, vectorized);
+	if (vectorized && std::string(decoder.name()) == "scalar")
+	{
+	    std::cout << "batch avx2\t\tnot supported by this CPU" << std::endl;
+	    break;
+	}
+	SignalColumns output;
+	decoder.decode(frames.data(), batch_size, output);
+	for (size_t signal = 0; signal < signals; ++signal)
+	{
+	    if (memcmp(output.values(signal), &columns[signal * batch_size], batch_size * sizeof(double)))
+	    {
+		std::cerr << "Error: batch decoder and decode plan disagree" << std::endl;
+		return 1;
+	    }
+	}
+
+	double seconds = measure(batches, [&]() {
+	    decoder.decode(frames.data(), batch_size, output);
+	    asm volatile("" : : "r"(output.values(0)) : "memory");
+	});
+	std::cout << "batch " << decoder.name() << "\t\t" << (unsigned long long)(total / seconds) << "\t"
+		  << seconds * 1e9 / (batches * batch_size) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+   CAN id dispatch benchmark: dispatch table against an if chain and std::unordered_map
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: dispatch_table_benchmark [frames]
+
+   Registers 1000 ids (700 standard, 300 extended) and dispatches a random stream of
+   frames in which 80% of the ids are registered.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/can.h>
+
+#include "../common/DispatchTable.hpp"
+
+typedef void (*Handler)(const canfd_frame&);
+
+static unsigned long long handled[4];
+
+static void handler0(const canfd_frame&) { ++handled[0]; }
+static void handler1(const canfd_frame&) { ++handled[1]; }
+static void handler2(const canfd_frame&) { ++handled[2]; }
+static void handler3(const canfd_frame&) { ++handled[3]; }
+
+static const Handler handlers[] = { handler0, handler1, handler2, handler3 };
+
+static unsigned long long total_handled()
+{
+    unsigned long long total = handled[0] + handled[1] + handled[2] + handled[3];
+    handled[0] = handled[1] = handled[2] = handled[3] = 0;
+    return total;
+}
+
+template <typename Function>
+static double measure(const std::vector<canfd_frame>& frames, Function dispatch)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (const canfd_frame& frame : frames)
+    {
+	dispatch(frame);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames.size();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    std::mt19937 random(42);
+
+    std::vector<canid_t> ids;
+    std::unordered_map<canid_t, Handler> map;
+    DispatchTable<Handler> table;
+    while (ids.size() < 1000)
+    {
+	canid_t id = ids.size() < 700 ? random() % (CAN_SFF_MASK + 1) : (random() & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	Handler handler = handlers[ids.size() % 4];
+	if (!table.add(id, handler))
+	    continue;
+	map[id] = handler;
+	ids.push_back(id);
+    }
+
+    std::vector<canfd_frame> frames(count);
+    for (canfd_frame& frame : frames)
+    {
+	if (random() % 5)
+	    frame.can_id = ids[random() % ids.size()];
+	else
+	    frame.can_id = (random() & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	frame.len = 8;
+    }
+
+    std::cout << "registered ids: " << table.size() << ", frames: " << count << std::endl;
+
+    double table_ns = measure(frames, [&table](const canfd_frame& frame) {
+	Handler handler = table.find(frame.can_id);
+	if (handler)
+	    handler(frame);
+    });
+    std::cout << "dispatch table\t" << table_ns << " ns/frame\t" << total_handled() << " handled" << std::endl;
+
+    double map_ns = measure(frames, [&map](const canfd_frame& frame) {
+	auto it = map.find(frame.can_id);
+	if (it != map.end())
+	    it->second(frame);
+    });
+    std::cout << "unordered_map\t" << map_ns << " ns/frame\t" << total_handled() << " handled" << std::endl;
+
+    // the comparison chain the console used to run, one compare per registered id
+    double chain_ns = measure(frames, [&ids](const canfd_frame& frame) {
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+	    if (frame.can_id == ids[i])
+		handlers[i % 4](frame);
+	}
+    });
+    std::cout << "if chain\t" << chain_ns << " ns/frame\t" << total_handled() << " handled" << std::endl;
+    return 0;
+}
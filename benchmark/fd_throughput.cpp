@@ -0,0 +1,194 @@
+/*
+   CAN FD against classic CAN throughput benchmark
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: fd_throughput_benchmark [interface] [seconds]
+
+   Frames are sent as fast as possible from one I/O engine to another, through two raw CAN
+   sockets with CAN FD enabled bound to the interface (e.g. vcan0), or through a datagram
+   socket pair when no interface is given. Classic 8 byte frames are compared with CAN FD
+   frames of 8 and 64 bytes, in frames and payload bytes per second on the socket, and in
+   frames per second a 500 kbit/s bus with a 2 Mbit/s data phase could carry.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../common/BusTiming.hpp"
+#include "../common/IoEngine.hpp"
+
+static int open_can_socket(const char* name)
+{
+    int can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (can_socket < 0)
+	return -1;
+
+    int enable_canfd = 1;
+    ifreq ifr;
+    sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    ifr.ifr_name[IFNAMSIZ - 1] = 0;
+    if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0 ||
+	setsockopt(can_socket, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable_canfd, sizeof(enable_canfd)) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+    return can_socket;
+}
+
+static bool open_sockets(const char* name, int& tx, int& rx)
+{
+    if (name)
+    {
+	tx = open_can_socket(name);
+	rx = open_can_socket(name);
+	if (tx >= 0 && rx >= 0)
+	    return true;
+	std::cerr << "Error: cannot use CAN interface " << name << " with CAN FD" << std::endl;
+	return false;
+    }
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) < 0)
+    {
+	std::cerr << "Error: cannot create socket pair" << std::endl;
+	return false;
+    }
+    tx = pair[0];
+    rx = pair[1];
+    return true;
+}
+
+struct Result
+{
+    unsigned long long frames;
+    unsigned long long bytes;
+    double seconds;
+};
+
+static Result run(const char* name, const canfd_frame& frame, int mtu, double duration)
+{
+    int tx, rx;
+    if (!open_sockets(name, tx, rx))
+	exit(-1);
+
+    std::unique_ptr<IoEngine> sender = IoEngine::create("uring", tx, 1, 32, std::chrono::microseconds(1000));
+    std::unique_ptr<IoEngine> receiver = IoEngine::create("uring", rx, 64, 1, std::chrono::microseconds(0));
+    if (!sender || !receiver)
+    {
+	std::cerr << "Error: cannot set up socket I/O" << std::endl;
+	exit(-2);
+    }
+
+    std::atomic<bool> running(true);
+    std::thread producer([&]() {
+	// sending never waits, so a full socket is waited for here
+	auto full = [&]() {
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+		return false;
+	    sender->waitWritable(std::chrono::microseconds(1000));
+	    return true;
+	};
+
+	while (running)
+	{
+	    for (int i = 0; i < 32 && running; ++i)
+	    {
+		while (!sender->queue(frame, mtu) && full() && running)
+		    ;
+	    }
+	    if (!sender->flush() && !full())
+		break;
+	}
+    });
+
+    Result result = {};
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+	int count = receiver->receive();
+	if (count < 0)
+	    break;
+	for (int i = 0; i < count; ++i)
+	{
+	    result.bytes += receiver->received(i).dataLength();
+	}
+	result.frames += count;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    running = false;
+    producer.join();
+    sender.reset();
+    receiver.reset();
+    close(tx);
+    close(rx);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const char* name = argc > 1 && argv[1][0] ? argv[1] : nullptr;
+    double duration = argc > 2 ? atof(argv[2]) : 2.0;
+    BusTiming timing(500000, 2000000, BusTiming::Stuffing::Exact);
+
+    struct Case
+    {
+	const char* label;
+	int mtu;
+	int length;
+	bool brs;
+    };
+    const Case cases[] = {
+	{ "classic 8", CAN_MTU, 8, false },
+	{ "fd 8", CANFD_MTU, 8, false },
+	{ "fd 64", CANFD_MTU, 64, false },
+	{ "fd 64 brs", CANFD_MTU, 64, true },
+    };
+
+    std::cout << "transport: " << (name ? name : "unix socket pair") << std::endl;
+    std::cout << std::left << std::setw(16) << "frame" << "socket fps\tpayload MB/s\tbus fps (500k/2M)\tbus payload kB/s" << std::endl;
+    for (const Case& c : cases)
+    {
+	canfd_frame frame;
+	memset(&frame, 0x5a, sizeof(frame));
+	frame.can_id = 0x123;
+	frame.len = c.length;
+	frame.flags = c.mtu == CANFD_MTU ? CANFD_FDF | (c.brs ? CANFD_BRS : 0) : 0;
+	frame.__res0 = 0;
+	frame.__res1 = 0;
+
+	Result result = run(name, frame, c.mtu, duration);
+	double bus_fps = 1e9 / timing.frameTime(frame, c.mtu);
+	std::cout << std::left << std::setw(16) << c.label
+		  << (unsigned long long)(result.frames / result.seconds) << "\t\t"
+		  << result.bytes / result.seconds / 1e6 << "\t\t"
+		  << (unsigned long long)bus_fps << "\t\t\t"
+		  << bus_fps * c.length / 1000.0 << std::endl;
+    }
+    return 0;
+}
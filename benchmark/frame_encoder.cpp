@@ -0,0 +1,96 @@
+/*
+   Frame encoding benchmark: precompiled encoders against memset plus per-byte patching
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: frame_encoder_benchmark [frames]
+
+   Encodes a speed message (a 16 bit big endian signal at byte 3) as a classic 8 byte frame
+   and as a 64 byte CAN FD frame, the way the controller used to (clear the frame, set the
+   header and patch the signal and filler bytes) and through a FrameEncoder. Filler bytes
+   are not randomized, so only the encoding itself is measured.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <linux/can.h>
+
+#include "../common/can.hpp"
+#include "../common/FrameEncoder.hpp"
+
+static const int position = 3;
+
+// consume the frame, so the compiler cannot drop the encoding
+static unsigned long long checksum;
+static void consume(const canfd_frame& frame)
+{
+    asm volatile("" : : "r"(&frame) : "memory");
+    checksum += frame.data[position + 1];
+}
+
+template <typename Function>
+static double measure(size_t count, Function encode)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+	encode(i);
+    }
+    return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void patch(canfd_frame& frame, unsigned long long speed, int length, bool fd)
+{
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = 580;
+    if (fd)
+    {
+	frame.len = CanMessage::fdLength(CanMessage::fdDlc(length));
+	frame.flags = CANFD_FDF | CANFD_BRS;
+    }
+    else
+    {
+	frame.len = std::min(length, CAN_MAX_DLEN);
+    }
+    frame.data[position + 1] = speed & 0xff;
+    frame.data[position] = (speed >> 8) & 0xff;
+    // the filler loop, with randomization off every byte is only tested
+    for (int i = position + 1; i < frame.len; ++i)
+    {
+	if (frame.data[i] == 0xff)
+	    frame.data[i] = 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+    canfd_frame frame;
+
+    std::cout << "frames: " << count << std::endl;
+    std::cout << "frame\t\tpatching fps\tencoder fps" << std::endl;
+    for (bool fd : { false, true })
+    {
+	int length = fd ? 64 : 8;
+	FrameEncoder encoder(580, length, fd, true, false);
+	encoder.addField(position, 2, true);
+	encoder.addFiller(0, position);
+	encoder.addFiller(position + 1, encoder.length());
+
+	double patching = measure(count, [&](size_t i) {
+	    patch(frame, i, length, fd);
+	    consume(frame);
+	});
+	double encoding = measure(count, [&](size_t i) {
+	    encoder.encode(frame, { i });
+	    consume(frame);
+	});
+	std::cout << (fd ? "fd 64\t" : "classic 8") << "\t" << (unsigned long long)patching << "\t"
+		  << (unsigned long long)encoding << std::endl;
+    }
+    std::cout << "checksum " << checksum << std::endl;
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*
+   Socket I/O backend benchmark: io_uring against epoll with sendmmsg()/recvmmsg()
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: io_engine_benchmark [interface] [seconds]
+
+   Frames travel from a sending engine to a receiving engine of the same backend, through
+   two raw CAN sockets bound to the interface (e.g. vcan0), or through a datagram socket
+   pair when no interface is given. Every frame carries its queueing time, so the receiver
+   measures the latency from queue() to receive().
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../common/IoEngine.hpp"
+#include "../common/LatencyHistogram.hpp"
+
+static int open_can_socket(const char* name)
+{
+    int can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (can_socket < 0)
+	return -1;
+
+    ifreq ifr;
+    sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    ifr.ifr_name[IFNAMSIZ - 1] = 0;
+    if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+    return can_socket;
+}
+
+static bool open_sockets(const char* name, int& tx, int& rx)
+{
+    if (name)
+    {
+	tx = open_can_socket(name);
+	rx = open_can_socket(name);
+	if (tx >= 0 && rx >= 0)
+	    return true;
+	std::cerr << "Error: cannot use CAN interface " << name << std::endl;
+	return false;
+    }
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) < 0)
+    {
+	std::cerr << "Error: cannot create socket pair" << std::endl;
+	return false;
+    }
+    tx = pair[0];
+    rx = pair[1];
+    return true;
+}
+
+static long long monotonic_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+struct Result
+{
+    std::string backend;
+    unsigned long long frames;
+    unsigned long long frames_sent;
+    unsigned long long tx_syscalls;
+    unsigned long long rx_syscalls;
+    double seconds;
+    LatencyHistogram latency;
+};
+
+/*
+   Offers frames at the requested rate (0 means as fast as possible), queueing whatever is
+   due and flushing it in one go, while the receiver reaps batches until the duration is over.
+*/
+static void run(const std::string& backend, const char* name, unsigned rate, double duration, Result& result)
+{
+    int tx, rx;
+    if (!open_sockets(name, tx, rx))
+	exit(-1);
+
+    std::unique_ptr<IoEngine> sender = IoEngine::create(backend, tx, 1, 32, std::chrono::microseconds(1000));
+    std::unique_ptr<IoEngine> receiver = IoEngine::create(backend, rx, 64, 1, std::chrono::microseconds(0));
+    if (!sender || !receiver)
+    {
+	std::cerr << "Error: cannot set up " << backend << " I/O" << std::endl;
+	exit(-2);
+    }
+    result.backend = receiver->name();
+
+    std::atomic<bool> running(true);
+    std::thread producer([&]() {
+	canfd_frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.can_id = 0x123;
+	frame.len = 8;
+
+	// sending never waits, so a full socket is waited for here
+	auto full = [&]() {
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+		return false;
+	    sender->waitWritable(std::chrono::microseconds(1000));
+	    return true;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned long long sent = 0;
+	while (running)
+	{
+	    unsigned long long due = sent + 32;
+	    if (rate)
+	    {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		due = elapsed * rate;
+		if (due <= sent)
+		{
+		    std::this_thread::sleep_for(std::chrono::microseconds(50));
+		    continue;
+		}
+	    }
+	    for (; sent < due; ++sent)
+	    {
+		long long stamp = monotonic_ns();
+		memcpy(frame.data, &stamp, sizeof(stamp));
+		while (!sender->queue(frame, CAN_MTU) && full() && running)
+		    ;
+	    }
+	    if (!sender->flush() && !full())
+		break;
+	}
+	// tells the receiver that nothing follows
+	long long stamp = 0;
+	memcpy(frame.data, &stamp, sizeof(stamp));
+	while (!sender->queue(frame, CAN_MTU) && full())
+	    ;
+	while (sender->pending() && !sender->flush() && full())
+	    ;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+	int count = receiver->receive();
+	if (count < 0)
+	    break;
+	long long now = monotonic_ns();
+	for (int i = 0; i < count; ++i)
+	{
+	    long long stamp;
+	    memcpy(&stamp, receiver->received(i).frame.data, sizeof(stamp));
+	    if (stamp)
+		result.latency.record(now - stamp);
+	}
+	result.frames += count;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.rx_syscalls = receiver->syscallCount();
+
+    // keep draining, a producer blocked on a full socket could never see running turn false
+    running = false;
+    bool last = false;
+    while (!last)
+    {
+	int count = receiver->receive();
+	if (count < 0)
+	    break;
+	for (int i = 0; i < count; ++i)
+	{
+	    long long stamp;
+	    memcpy(&stamp, receiver->received(i).frame.data, sizeof(stamp));
+	    if (!stamp)
+		last = true;
+	}
+    }
+    producer.join();
+    result.frames_sent = sender->framesSent();
+    result.tx_syscalls = sender->syscallCount();
+    sender.reset();
+    receiver.reset();
+    close(tx);
+    close(rx);
+}
+
+int main(int argc, char **argv)
+{
+    const char* name = argc > 1 && argv[1][0] ? argv[1] : nullptr;
+    double duration = argc > 2 ? atof(argv[2]) : 2.0;
+    std::vector<unsigned> rates = { 10000, 0 };
+
+    std::cout << "transport: " << (name ? name : "unix socket pair") << std::endl;
+    std::cout << "offered fps\tbackend\treceived fps\ttx syscalls/1000\trx syscalls/1000\tp50 us\tp99 us" << std::endl;
+    for (unsigned rate : rates)
+    {
+	for (const char* backend : { "epoll", "uring" })
+	{
+	    Result result = {};
+	    run(backend, name, rate, duration, result);
+	    double frames = result.frames ? result.frames : 1;
+	    double frames_sent = result.frames_sent ? result.frames_sent : 1;
+	    std::cout << (rate ? std::to_string(rate) : std::string("max")) << "\t\t"
+		      << result.backend << "\t"
+		      << (unsigned long long)(result.frames / result.seconds) << "\t\t"
+		      << 1000.0 * result.tx_syscalls / frames_sent << "\t\t\t"
+		      << 1000.0 * result.rx_syscalls / frames << "\t\t\t"
+		      << result.latency.percentile(0.5) / 1000.0 << "\t"
+		      << result.latency.percentile(0.99) / 1000.0 << std::endl;
+	}
+    }
+    return 0;
+}
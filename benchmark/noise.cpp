@@ -0,0 +1,76 @@
+/*
+   Obfuscation noise benchmark: rand() per byte, the vectorized NoiseGenerator and the NoisePool
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: noise_benchmark [frames]
+
+   Randomizes the filler bytes of a classic 8 byte frame and of a 64 byte CAN FD frame
+   (everything but a one byte signal at the start), the way the controller used to with two
+   rand() calls per replaced byte, through a NoiseGenerator and from a NoisePool refilled by
+   its helper thread, and reports frames per second.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "../common/NoiseGenerator.hpp"
+#include "../common/NoisePool.hpp"
+
+// consume the frame, so the compiler cannot drop the randomization
+static unsigned long long checksum;
+static void consume(const unsigned char *data, int length)
+{
+    asm volatile("" : : "r"(data) : "memory");
+    checksum += data[length - 1];
+}
+
+template <typename Function>
+static double measure(size_t count, Function randomize)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+	randomize();
+    }
+    return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    unsigned char data[64] = {};
+
+    std::cout << "frames: " << count << std::endl;
+    std::cout << "frame\t\trand() fps\tnoise generator fps\tnoise pool fps" << std::endl;
+    for (int length : { 8, 64 })
+    {
+	srand(1);
+	double libc = measure(count, [&]() {
+	    for (int i = 1; i < length; ++i)
+	    {
+		if (rand() % 3 < 1)
+		    data[i] = rand() % 255;
+	    }
+	    consume(data, length);
+	});
+
+	NoiseGenerator noise(1, 2, 0);
+	double vector = measure(count, [&]() {
+	    noise.scramble(data, 1, length);
+	    consume(data, length);
+	});
+
+	NoisePool pool({ NoiseGenerator(1, 2, 0) }, 65536, 4);
+	double precomputed = measure(count, [&]() {
+	    pool.scramble(0, data, 1, length);
+	    consume(data, length);
+	});
+
+	std::cout << (length > 8 ? "CAN FD 64\t" : "classic 8\t")
+		  << (unsigned long long)libc << "\t"
+		  << (unsigned long long)vector << "\t\t"
+		  << (unsigned long long)precomputed << std::endl;
+    }
+    return checksum == 0;
+}
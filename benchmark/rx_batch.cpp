@@ -0,0 +1,212 @@
+/*
+   Receive path benchmark: one recvmsg() per frame against batched recvmmsg()
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: rx_batch_benchmark [interface] [seconds]
+
+   With an interface (e.g. vcan0) frames travel through two raw CAN sockets bound to it.
+   Without one, a datagram socket pair is used so the syscall cost can be measured on
+   machines without CAN support.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../common/RxBatch.hpp"
+#include "../common/TxBatch.hpp"
+
+static int open_can_socket(const char* name)
+{
+    int can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (can_socket < 0)
+	return -1;
+
+    ifreq ifr;
+    sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    ifr.ifr_name[IFNAMSIZ - 1] = 0;
+    if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+    return can_socket;
+}
+
+static bool open_sockets(const char* name, int& tx, int& rx)
+{
+    if (name)
+    {
+	tx = open_can_socket(name);
+	rx = open_can_socket(name);
+	if (tx >= 0 && rx >= 0)
+	    return true;
+	std::cerr << "Error: cannot use CAN interface " << name << std::endl;
+	return false;
+    }
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) < 0)
+    {
+	std::cerr << "Error: cannot create socket pair" << std::endl;
+	return false;
+    }
+    tx = pair[0];
+    rx = pair[1];
+    return true;
+}
+
+static double thread_cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+	(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Result
+{
+    unsigned long long frames;
+    unsigned long long syscalls;
+    double seconds;
+    double cpu_seconds;
+};
+
+/*
+   Offers frames at the requested rate (0 means as fast as possible) for the given duration,
+   while the receiver runs either the single frame or the batched receive loop.
+*/
+static Result run(const char* name, bool batched, unsigned rate, double duration)
+{
+    Result result = {};
+    int tx, rx;
+    if (!open_sockets(name, tx, rx))
+	exit(-1);
+
+    // neither side may block forever once the other one has stopped
+    timeval timeout = { 0, 100000 };
+    setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(tx, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::atomic<bool> running(true);
+    std::thread producer([&]() {
+	TxBatch batch(tx, 32, std::chrono::microseconds(1000));
+	canfd_frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.can_id = 0x123;
+	frame.len = 8;
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned long long sent = 0;
+	while (running)
+	{
+	    if (rate)
+	    {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (sent >= elapsed * rate)
+		{
+		    std::this_thread::sleep_for(std::chrono::microseconds(100));
+		    continue;
+		}
+	    }
+	    for (int i = 0; i < 32; ++i)
+	    {
+		frame.data[0] = sent & 0xff;
+		batch.queue(frame, CAN_MTU);
+		++sent;
+	    }
+	    if (!batch.flush() && errno != ENOBUFS && errno != EAGAIN)
+		break;
+	}
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(duration);
+    double cpu_start = thread_cpu_seconds();
+
+    if (batched)
+    {
+	RxBatch batch(rx, 64);
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+	    int count = batch.receive();
+	    if (count > 0)
+		result.frames += count;
+	}
+	result.syscalls = batch.syscallCount();
+    }
+    else
+    {
+	canfd_frame frame;
+	iovec iov = { &frame, sizeof(frame) };
+	char control[CMSG_SPACE(sizeof(timeval)) + CMSG_SPACE(sizeof(__u32))];
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+	    msg.msg_controllen = sizeof(control);
+	    int nbytes = recvmsg(rx, &msg, 0);
+	    ++result.syscalls;
+	    if (nbytes > 0)
+		++result.frames;
+	}
+    }
+
+    result.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    running = false;
+    producer.join();
+    close(tx);
+    close(rx);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const char* name = argc > 1 && argv[1][0] ? argv[1] : nullptr;
+    double duration = argc > 2 ? atof(argv[2]) : 2.0;
+    std::vector<unsigned> rates = { 10000, 50000, 0 };
+
+    std::cout << "transport: " << (name ? name : "unix socket pair") << std::endl;
+    std::cout << "offered fps\tmode\t\treceived fps\tframes/syscall\tcpu ns/frame" << std::endl;
+    for (unsigned rate : rates)
+    {
+	for (bool batched : { false, true })
+	{
+	    Result result = run(name, batched, rate, duration);
+	    std::cout << (rate ? std::to_string(rate) : std::string("max")) << "\t\t"
+		      << (batched ? "recvmmsg" : "recvmsg ") << "\t"
+		      << (unsigned long long)(result.frames / result.seconds) << "\t\t"
+		      << (result.syscalls ? (double)result.frames / result.syscalls : 0.0) << "\t\t"
+		      << (result.frames ? result.cpu_seconds * 1e9 / result.frames : 0.0) << std::endl;
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+   Capture path benchmark: CAN_RAW socket with recvmmsg() against a TPACKET_V3 ring
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: rx_capture_benchmark [interface] [seconds]
+
+   Frames are sent as fast as possible on the interface (vcan0 by default) and captured
+   either through a raw CAN socket read with recvmmsg() or through the memory mapped
+   AF_PACKET ring the console uses in mmap capture mode. Needs a CAN interface and,
+   for the ring, CAP_NET_RAW.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../common/PacketRing.hpp"
+#include "../common/RxBatch.hpp"
+#include "../common/TxBatch.hpp"
+
+static int open_can_socket(const char* name)
+{
+    int can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (can_socket < 0)
+	return -1;
+
+    ifreq ifr;
+    sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    ifr.ifr_name[IFNAMSIZ - 1] = 0;
+    if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+	close(can_socket);
+	return -1;
+    }
+    return can_socket;
+}
+
+static double thread_cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+	(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct Result
+{
+    unsigned long long frames;
+    unsigned long long syscalls;
+    unsigned long long drops;
+    double seconds;
+    double cpu_seconds;
+};
+
+// drains the capture source until the deadline, counting what it delivered
+template <typename Source>
+static void capture(Source& source, Result& result, std::chrono::steady_clock::time_point deadline)
+{
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+	int count = source.receive();
+	if (count < 0)
+	    break;
+	result.frames += count;
+    }
+    result.syscalls = source.syscallCount();
+    result.drops = source.kernelDrops();
+}
+
+static Result run(const char* name, bool ring, double duration)
+{
+    Result result = {};
+    int tx = open_can_socket(name);
+    if (tx < 0)
+    {
+	std::cerr << "Error: cannot use CAN interface " << name << std::endl;
+	exit(-1);
+    }
+    timeval timeout = { 0, 100000 };
+    setsockopt(tx, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    int rx = -1;
+    PacketRing packet_ring;
+    if (ring)
+    {
+	// a short block timeout keeps poll() from hanging once the producer has stopped
+	if (!packet_ring.open(name, 65536, 64, 1))
+	{
+	    std::cerr << "Error: cannot set up packet ring on " << name << ": " << strerror(errno) << std::endl;
+	    exit(-2);
+	}
+    }
+    else
+    {
+	rx = open_can_socket(name);
+	setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    std::atomic<bool> running(true);
+    std::thread producer([&]() {
+	TxBatch batch(tx, 32, std::chrono::microseconds(1000));
+	canfd_frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.can_id = 0x123;
+	frame.len = 8;
+
+	unsigned long long sent = 0;
+	while (running)
+	{
+	    for (int i = 0; i < 32; ++i)
+	    {
+		frame.data[0] = sent & 0xff;
+		batch.queue(frame, CAN_MTU);
+		++sent;
+	    }
+	    if (!batch.flush() && errno != ENOBUFS && errno != EAGAIN)
+		break;
+	}
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+    double cpu_start = thread_cpu_seconds();
+
+    if (ring)
+    {
+	capture(packet_ring, result, deadline);
+    }
+    else
+    {
+	RxBatch batch(rx, 64);
+	capture(batch, result, deadline);
+    }
+
+    result.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    running = false;
+    producer.join();
+    close(tx);
+    if (rx >= 0)
+	close(rx);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const char* name = argc > 1 && argv[1][0] ? argv[1] : "vcan0";
+    double duration = argc > 2 ? atof(argv[2]) : 2.0;
+
+    std::cout << "interface: " << name << std::endl;
+    std::cout << "mode\t\treceived fps\tsyscalls/1000 frames\tkernel drops\tcpu ns/frame" << std::endl;
+    for (bool ring : { false, true })
+    {
+	Result result = run(name, ring, duration);
+	std::cout << (ring ? "mmap ring" : "recvmmsg ") << "\t"
+		  << (unsigned long long)(result.frames / result.seconds) << "\t\t"
+		  << (result.frames ? 1000.0 * result.syscalls / result.frames : 0.0) << "\t\t\t"
+		  << result.drops << "\t\t"
+		  << (result.frames ? result.cpu_seconds * 1e9 / result.frames : 0.0) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+   Signal decoding benchmark: walking the DBC signal definitions against compiled decode plans
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: signal_decode_benchmark [frames]
+
+   Builds a 64 byte CAN FD message with 50 signals of 1 to 16 bits, mixing Intel and
+   Motorola byte order and signed and unsigned values, and a multiplexed one with an 8 bit
+   multiplexor and 49 such signals under each of its 256 values. Random payloads are
+   decoded into physical values, once by interpreting every signal definition bit by bit
+   per frame (testing the multiplexor value of every multiplexed signal) and once through
+   a MessageDecoder. Both must agree, the rate of each is reported.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/MessageDecoder.hpp"
+#include "../common/SignalDatabase.hpp"
+
+static const int signal_count = 50;
+
+// signals follow each other from first_bit on, Motorola ones counted from the most significant bit of byte 0
+static void add_signals(DbcMessage& message, int first_bit, int count, DbcSignal::Multiplexing multiplexing, unsigned mux_value)
+{
+    std::minstd_rand random(1 + mux_value);
+    int bit = first_bit;
+    for (int i = 0; i < count; ++i)
+    {
+	DbcSignal signal;
+	signal.name = "signal" + std::to_string(message.signals.size());
+	signal.length = 1 + random() % 16;
+	signal.big_endian = i % 2;
+	signal.is_signed = i % 3 == 0;
+	signal.factor = 0.5;
+	signal.offset = -10;
+	signal.minimum = 0;
+	signal.maximum = 0;
+	signal.multiplexing = multiplexing;
+	signal.mux_value = mux_value;
+	if (bit + signal.length > 8 * message.length)
+	    break;
+	signal.start_bit = signal.big_endian ? bit / 8 * 8 + 7 - bit % 8 : bit;
+	message.signals.push_back(signal);
+	bit += signal.length;
+    }
+}
+
+static DbcMessage build_message(bool multiplexed)
+{
+    DbcMessage message;
+    message.id = 0x400;
+    message.name = "Benchmark";
+    message.length = 64;
+    if (!multiplexed)
+    {
+	add_signals(message, 0, signal_count, DbcSignal::Plain, 0);
+	return message;
+    }
+
+    DbcSignal multiplexor = { "mode", 0, 8, false, false, 1, 0, 0, 255, "", DbcSignal::Multiplexor, 0 };
+    message.signals.push_back(multiplexor);
+    for (unsigned value = 0; value < 256; ++value)
+    {
+	add_signals(message, 8, signal_count - 1, DbcSignal::Multiplexed, value);
+    }
+    return message;
+}
+
+static void interpret(const DbcMessage& message, const unsigned char *data, double *values)
+{
+    long long mux = -1;
+    for (size_t i = 0; i < message.signals.size(); ++i)
+    {
+	const DbcSignal& signal = message.signals[i];
+	if (signal.multiplexing == DbcSignal::Multiplexed && (long long)signal.mux_value != mux)
+	    continue;
+	unsigned long long raw = SignalDatabase::rawValue(signal, data);
+	long long value = raw;
+	if (signal.is_signed && signal.length < 64)
+	    value = (long long)(raw << (64 - signal.length)) >> (64 - signal.length);
+	if (signal.multiplexing == DbcSignal::Multiplexor)
+	    mux = value;
+	values[i] = value * signal.factor + signal.offset;
+    }
+}
+
+template <typename Function>
+static double measure(size_t count, Function decode)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+	decode(i);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 2000000;
+
+    std::minstd_rand random(2);
+    std::vector<unsigned char> payloads(256 * 64);
+    for (unsigned char& byte : payloads)
+    {
+	byte = random();
+    }
+
+    std::cout << "frames: " << count << std::endl;
+    std::cout << "message\t\tsignals\tinterpreted ns/frame\tcompiled ns/frame" << std::endl;
+    for (bool multiplexed : { false, true })
+    {
+	DbcMessage message = build_message(multiplexed);
+	MessageDecoder decoder(message);
+
+	std::vector<double> expected(message.signals.size());
+	std::vector<double> values(message.signals.size());
+	for (size_t frame = 0; frame < 256; ++frame)
+	{
+	    interpret(message, &payloads[frame * 64], expected.data());
+	    decoder.decode(&payloads[frame * 64], 64, values.data());
+	    if (expected != values)
+	    {
+		std::cerr << "Error: decoder and signal definitions disagree" << std::endl;
+		return 1;
+	    }
+	}
+
+	double interpreted = measure(count, [&](size_t i) {
+	    interpret(message, &payloads[(i & 255) * 64], values.data());
+	    asm volatile("" : : "r"(values.data()) : "memory");
+	});
+	double compiled = measure(count, [&](size_t i) {
+	    decoder.decode(&payloads[(i & 255) * 64], 64, values.data());
+	    asm volatile("" : : "r"(values.data()) : "memory");
+	});
+
+	std::cout << (multiplexed ? "multiplexed\t" : "plain\t\t") << message.signals.size() << "\t"
+		  << interpreted * 1e9 / count << "\t\t\t" << compiled * 1e9 / count << std::endl;
+    }
+    return 0;
+}
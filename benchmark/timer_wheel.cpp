@@ -0,0 +1,88 @@
+/*
+   Scheduling overhead benchmark: hierarchical timer wheel against a linear scan
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: timer_wheel_benchmark [ticks] [expiries per tick]
+
+   Registers N periodic jobs and advances the simulated clock (one tick = 1 ms). The
+   period of the jobs grows with N (N / expiries per tick ticks, 10 ms to 1 s for the
+   default rate of 10), so every size does the same amount of work per tick and only
+   the bookkeeping differs. The cost per tick of the wheel should stay flat as N grows,
+   while the linear scan (what the scheduler did before) pays for every job on every tick.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../common/TimerWheel.hpp"
+
+int main(int argc, char **argv)
+{
+    uint64_t ticks = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+    uint64_t rate = argc > 2 ? strtoull(argv[2], NULL, 10) : 10;
+    if (!rate)
+	rate = 1;
+    std::vector<size_t> sizes = { 100, 500, 1000, 2000, 3000, 10000 };
+
+    std::cout << "jobs\tperiod\texpiries/tick\twheel ns/tick\twheel ns/expiry\tscan ns/tick\tscan ns/expiry" << std::endl;
+    for (size_t jobs : sizes)
+    {
+	uint64_t period = jobs / rate ? jobs / rate : 1;
+	std::mt19937 random(jobs);
+	std::vector<uint64_t> job_offsets(jobs);
+	for (size_t i = 0; i < jobs; ++i)
+	{
+	    job_offsets[i] = 1 + random() % period;
+	}
+
+	unsigned long long wheel_expiries = 0;
+	uint64_t wheel_sum = 0;
+	TimerWheel wheel;
+	for (size_t i = 0; i < jobs; ++i)
+	{
+	    wheel.schedule(job_offsets[i], period, i);
+	}
+	// let every slot array reach its steady state size before measuring
+	uint64_t warmup = 2 * period + 1024;
+	wheel.advance(warmup, [](uint64_t) {});
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t tick = 1; tick <= ticks; ++tick)
+	{
+	    wheel.advance(warmup + tick, [&](uint64_t job) { ++wheel_expiries; wheel_sum += job; });
+	}
+	double wheel_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	// the old approach: look at every job on every tick
+	unsigned long long scan_expiries = 0;
+	uint64_t scan_sum = 0;
+	std::vector<uint64_t> next_release(job_offsets);
+	start = std::chrono::steady_clock::now();
+	for (uint64_t tick = 1; tick <= ticks; ++tick)
+	{
+	    for (size_t i = 0; i < jobs; ++i)
+	    {
+		if (next_release[i] <= tick)
+		{
+		    ++scan_expiries;
+		    scan_sum += i;
+		    next_release[i] += period;
+		}
+	    }
+	}
+	double scan_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	// the sums keep the compiler from dropping the handlers
+	if (wheel_sum == 1 && scan_sum == 1)
+	    std::cout << "";
+
+	std::cout << jobs << "\t" << period << "\t" << (double)wheel_expiries / ticks << "\t\t"
+		  << wheel_ns / ticks << "\t\t" << wheel_ns / wheel_expiries << "\t\t"
+		  << scan_ns / ticks << "\t\t" << scan_ns / scan_expiries << std::endl;
+    }
+    return 0;
+}
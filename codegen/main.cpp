@@ -0,0 +1,297 @@
+/*
+   Message layout code generator for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+
+   Usage: codegen <config.json> <output header> [DBC file]
+
+   Writes a header with the message layout of the configuration (and the messages of the
+   DBC file) as constexpr structs over the BakedCodec.hpp templates, for builds with the
+   SIMULATOR_BAKED_LAYOUT option.
+*/
+
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../common/ConfigurationParser.hpp"
+#include "../common/DecodePlan.hpp"
+#include "../common/SignalDatabase.hpp"
+#include "../common/VehicleMessage.hpp"
+
+// BakedField type of a signal, false if no 64 bit window holds it
+static bool field_type(const DbcSignal& signal, std::string& type)
+{
+    DbcMessage message;
+    message.signals.push_back(signal);
+    message.signals.back().multiplexing = DbcSignal::Plain;
+    DecodePlan plan(message);
+
+    for (bool big : { false, true })
+    {
+	for (const DecodePlan::Step& step : plan.steps(big))
+	{
+	    std::ostringstream out;
+	    out << "BakedField<" << (int)step.byte << ", " << (int)step.shift << ", 0x" << std::hex << step.mask
+		<< std::dec << "ULL, " << (int)step.sign_shift << ", " << (big ? "true" : "false") << ">";
+	    type = out.str();
+	    return true;
+	}
+    }
+    return false;
+}
+
+static std::string hex_id(canid_t id)
+{
+    std::ostringstream out;
+    out << "0x" << std::hex << id;
+    return out.str();
+}
+
+// DBC names are C identifiers already, anything else is made one
+static std::string identifier(const std::string& name, const std::set<std::string>& reserved)
+{
+    std::string result;
+    for (char c : name)
+    {
+	result += isalnum((unsigned char)c) ? c : '_';
+    }
+    if (result.empty() || isdigit((unsigned char)result[0]))
+	result = "_" + result;
+    while (reserved.count(result))
+	result += "_";
+    return result;
+}
+
+static bool write_vehicle_message(std::ostream& out, const char* name, const MessageLayout& message, const DbcSignal& value)
+{
+    std::string type;
+    if (!field_type(value, type))
+    {
+	std::cerr << "Error: the " << name << " signal does not fit a 64 bit window" << std::endl;
+	return false;
+    }
+
+    out << "    struct " << name << "\n"
+	<< "    {\n"
+	<< "\tstatic constexpr int id = " << message.id << ";\n"
+	<< "\tstatic constexpr canid_t frame_id = " << hex_id(CanMessage::frameId(message.id)) << ";\n"
+	<< "\tstatic constexpr int position = " << message.position << ";\n"
+	<< "\tstatic constexpr int length = " << message.length << ";\n"
+	<< "\tstatic constexpr int frame_length = " << message.frame_length << ";\n"
+	<< "\tstatic constexpr int period = " << message.period << ";\n"
+	<< "\tstatic constexpr int offset = " << message.offset << ";\n"
+	<< "\tstatic constexpr bool fd = " << (message.fd ? "true" : "false") << ";\n"
+	<< "\tstruct Value : " << type << "\n"
+	<< "\t{\n"
+	<< "\t    static constexpr int index = 0;\n"
+	<< "\t    static constexpr int needed = " << SignalDatabase::endByte(value) << ";\n"
+	<< "\t};\n"
+	<< "    };\n\n";
+    return true;
+}
+
+static bool write_database_message(std::ostream& out, const DbcMessage& message)
+{
+    static const std::set<std::string> reserved = { "id", "length", "signal_count", "Signals", "decode" };
+    std::string name = identifier(message.name, { "decode" });
+    std::vector<std::string> names;
+    // a member cannot have the name of its class
+    std::set<std::string> taken(reserved);
+    taken.insert(name);
+    for (const DbcSignal& signal : message.signals)
+    {
+	names.push_back(identifier(signal.name, taken));
+	taken.insert(names.back());
+    }
+
+    out << "\tstruct " << name << "\n"
+	<< "\t{\n"
+	<< "\t    static constexpr canid_t id = " << hex_id(message.id) << ";\n"
+	<< "\t    static constexpr int length = " << message.length << ";\n"
+	<< "\t    static constexpr size_t signal_count = " << message.signals.size() << ";\n\n";
+
+    std::map<unsigned, std::vector<std::string>> groups;
+    std::vector<std::string> always;
+    std::string multiplexor;
+    out << std::setprecision(17);
+    for (size_t i = 0; i < message.signals.size(); ++i)
+    {
+	const DbcSignal& signal = message.signals[i];
+	std::string type;
+	if (!field_type(signal, type))
+	{
+	    std::cerr << "Error: signal " << signal.name << " of " << message.name
+		      << " does not fit a 64 bit window, it cannot be baked" << std::endl;
+	    return false;
+	}
+	out << "\t    // " << signal.name << (signal.unit.empty() ? "" : " [" + signal.unit + "]") << "\n"
+	    << "\t    struct " << names[i] << " : " << type << "\n"
+	    << "\t    {\n"
+	    << "\t\tstatic constexpr double factor = " << signal.factor << ";\n"
+	    << "\t\tstatic constexpr double offset = " << signal.offset << ";\n"
+	    << "\t\tstatic constexpr int index = " << i << ";\n"
+	    << "\t\tstatic constexpr int needed = " << SignalDatabase::endByte(signal) << ";\n"
+	    << "\t    };\n";
+
+	if (signal.multiplexing == DbcSignal::Multiplexed)
+	{
+	    groups[signal.mux_value].push_back(names[i]);
+	    continue;
+	}
+	always.push_back(names[i]);
+	if (signal.multiplexing == DbcSignal::Multiplexor)
+	    multiplexor = names[i];
+    }
+
+    auto list = [](const std::vector<std::string>& signals) {
+	std::string result;
+	for (const std::string& signal : signals)
+	{
+	    result += (result.empty() ? "" : ", ") + signal;
+	}
+	return result;
+    };
+
+    out << "\n\t    using Signals = BakedSignals<" << list(always) << ">;\n\n"
+	<< "\t    static bool decode(const unsigned char *data, int payload_length, double *values)\n"
+	<< "\t    {\n";
+    if (multiplexor.empty())
+    {
+	out << "\t\treturn Signals::decode(data, payload_length, values);\n";
+    }
+    else
+    {
+	out << "\t\tif (!Signals::decode(data, payload_length, values))\n"
+	    << "\t\t    return false;\n"
+	    << "\t\tswitch (" << multiplexor << "::decode(data))\n"
+	    << "\t\t{\n";
+	for (const auto& group : groups)
+	{
+	    out << "\t\tcase " << group.first << ":\n"
+		<< "\t\t    return BakedSignals<" << list(group.second) << ">::decode(data, payload_length, values);\n";
+	}
+	out << "\t\tdefault:\n"
+	    << "\t\t    return true;\n"
+	    << "\t\t}\n";
+    }
+    out << "\t    }\n"
+	<< "\t};\n\n";
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+	std::cerr << "Usage: " << argv[0] << " <config.json> <output header> [DBC file]" << std::endl;
+	return -1;
+    }
+
+    ConfigurationParser parser(argv[1]);
+    std::optional<SimulationConfig> config = parser.parse();
+    if (!config)
+    {
+	std::cerr << "Error: could not parse configuration file." << std::endl;
+	return -100;
+    }
+
+    SignalDatabase database;
+    if (argc > 3 && argv[3][0] && !database.load(argv[3]))
+	return -2;
+
+    std::ostringstream out;
+    out << "/*\n"
+	<< "   Message layout for car CAN bus simulator, generated by codegen from " << argv[1];
+    if (argc > 3 && argv[3][0])
+	out << "\n   and " << argv[3];
+    out << "\n   Do not edit, regenerate it from the configuration instead.\n"
+	<< "*/\n\n"
+	<< "#ifndef BAKED_LAYOUT_HPP\n"
+	<< "#define BAKED_LAYOUT_HPP\n\n"
+	<< "#include <cstddef>\n\n"
+	<< "#include <linux/can.h>\n\n"
+	<< "#include \"BakedCodec.hpp\"\n"
+	<< "#include \"SimulationConfig.hpp\"\n\n"
+	<< "namespace BakedLayout\n"
+	<< "{\n";
+
+    const SimulationConfig::Messages& messages = config->messages;
+    bool written =
+	write_vehicle_message(out, "Door", messages.door, vehicleMessage(messages.door, VehicleSignal::Door).signals[0]) &&
+	write_vehicle_message(out, "Signal", messages.signal, vehicleMessage(messages.signal, VehicleSignal::TurnSignal).signals[0]) &&
+	write_vehicle_message(out, "Speed", messages.speed, vehicleMessage(messages.speed, VehicleSignal::Speed).signals[0]) &&
+	write_vehicle_message(out, "Diagnostic", messages.diagnostic, vehicleMessage(messages.diagnostic, VehicleSignal::Diagnostic).signals[0]);
+    if (!written)
+	return -3;
+
+    out << "    constexpr bool brs = " << (messages.brs ? "true" : "false") << ";\n"
+	<< "    constexpr bool esi = " << (messages.esi ? "true" : "false") << ";\n\n";
+
+    out << "    // the configuration with the baked layout in place of the configured one\n"
+	<< "    inline SimulationConfig apply(SimulationConfig config)\n"
+	<< "    {\n";
+    for (const char* name : { "Door", "Signal", "Speed", "Diagnostic" })
+    {
+	std::string member = name;
+	member[0] = tolower(member[0]);
+	out << "\tconfig.messages." << member << " = { " << name << "::id, " << name << "::position, " << name << "::length, "
+	    << name << "::frame_length, " << name << "::period, " << name << "::offset, " << name << "::fd };\n";
+    }
+    out << "\tconfig.messages.brs = brs;\n"
+	<< "\tconfig.messages.esi = esi;\n"
+	<< "\treturn config;\n"
+	<< "    }\n\n";
+
+    out << "    // messages of the DBC file\n"
+	<< "    namespace Dbc\n"
+	<< "    {\n";
+    std::set<canid_t> ids;
+    std::vector<std::string> decoded;
+    for (const DbcMessage& message : database.messages())
+    {
+	if (!ids.insert(message.id).second)
+	{
+	    std::cerr << "Warning: DBC message " << message.name << " repeats the id of another message, it is left out" << std::endl;
+	    continue;
+	}
+	if (!write_database_message(out, message))
+	    return -3;
+	decoded.push_back(identifier(message.name, { "decode" }));
+    }
+    // without any message the payload parameters go unused, so they stay unnamed
+    const char *parameters = decoded.empty() ? "const unsigned char *, int, double *"
+	: "const unsigned char *data, int payload_length, double *values";
+    out << "\t// decode a frame of any of the messages, false for other ids and short payloads\n"
+	<< "\tinline bool decode(canid_t id, " << parameters << ")\n"
+	<< "\t{\n"
+	<< "\t    switch (id)\n"
+	<< "\t    {\n";
+    for (const std::string& name : decoded)
+    {
+	out << "\t    case " << name << "::id:\n"
+	    << "\t\treturn " << name << "::decode(data, payload_length, values);\n";
+    }
+    out << "\t    default:\n"
+	<< "\t\treturn false;\n"
+	<< "\t    }\n"
+	<< "\t}\n"
+	<< "    }\n"
+	<< "}\n\n"
+	<< "#endif\n";
+
+    std::ofstream header(argv[2]);
+    header << out.str();
+    if (!header)
+    {
+	std::cerr << "Error: cannot write " << argv[2] << std::endl;
+	return -4;
+    }
+    return 0;
+}
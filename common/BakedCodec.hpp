@@ -0,0 +1,84 @@
+/*
+   Compile time signal codecs for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef BAKED_CODEC_HPP
+#define BAKED_CODEC_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <endian.h>
+
+/*
+   Building blocks of the layout header the codegen tool writes from config.json (and a DBC
+   file), for builds with SIMULATOR_BAKED_LAYOUT.
+
+   A field is a DecodePlan step turned into template arguments: the payload byte its 64 bit
+   window starts at, the shift and mask isolating it, the sign extension shift and the byte
+   order. Every offset and mask is then a constant the compiler folds into the loads and
+   stores, where the runtime configured path reads them from memory for every frame.
+*/
+template <int Byte, int Shift, unsigned long long Mask, int SignShift, bool BigEndian>
+struct BakedField
+{
+    static_assert(Byte >= 0 && Byte <= 56, "the 64 bit window must lie in the CAN FD payload");
+
+    // physical value = raw * factor + offset, generated signals replace these
+    static constexpr double factor = 1;
+    static constexpr double offset = 0;
+
+    static uint64_t load(const unsigned char *data)
+    {
+	uint64_t word;
+	memcpy(&word, data + Byte, sizeof(word));
+	return BigEndian ? be64toh(word) : le64toh(word);
+    }
+
+    // raw value, sign extended
+    static long long decode(const unsigned char *data)
+    {
+	return (long long)(((load(data) >> Shift) & Mask) << SignShift) >> SignShift;
+    }
+
+    // store the raw value, leaving the other bits of the window alone
+    static void encode(unsigned char *data, unsigned long long value)
+    {
+	uint64_t word = load(data);
+	word = (word & ~(Mask << Shift)) | ((value & Mask) << Shift);
+	word = BigEndian ? htobe64(word) : htole64(word);
+	memcpy(data + Byte, &word, sizeof(word));
+    }
+};
+
+/*
+   The signals of a message (or of one multiplexor value), each with its index in the
+   message and the payload bytes it needs. Decoding unrolls into one field decode per signal.
+*/
+template <typename... Signals>
+struct BakedSignals
+{
+    static constexpr size_t count = sizeof...(Signals);
+    static constexpr int needed = std::max({ 0, Signals::needed... });
+
+    static bool decode(const unsigned char *data, int length, double *values)
+    {
+	if (length < needed)
+	    return false;
+	((values[Signals::index] = Signals::decode(data) * Signals::factor + Signals::offset), ...);
+	return true;
+    }
+
+    static bool decodeRaw(const unsigned char *data, int length, long long *raw)
+    {
+	if (length < needed)
+	    return false;
+	((raw[Signals::index] = Signals::decode(data)), ...);
+	return true;
+    }
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+   Columnar batch signal decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "BatchDecoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_DECODER_AVX2 1
+#endif
+
+void SignalColumns::resize(size_t signals, size_t rows)
+{
+    // capacity only grows, so decoding batches of the same size never allocates
+    if (signals * rows > raw_data.size())
+    {
+	raw_data.resize(signals * rows);
+	value_data.resize(signals * rows);
+    }
+    if (rows > valid_data.size())
+	valid_data.resize(rows);
+    signal_count = signals;
+    row_count = rows;
+    capacity = rows;
+}
+
+BatchDecoder::BatchDecoder(const DbcMessage& message, bool vectorized)
+    : plan(message), id(message.id), avx2(false)
+{
+#ifdef BATCH_DECODER_AVX2
+    avx2 = vectorized && __builtin_cpu_supports("avx2");
+#else
+    (void)vectorized;
+#endif
+}
+
+BatchDecoder::BatchDecoder(const MessageLayout& layout, VehicleSignal signal, bool vectorized)
+    : BatchDecoder(vehicleMessage(layout, signal), vectorized)
+{
+}
+
+size_t BatchDecoder::decode(const canfd_frame *frames, size_t count, SignalColumns& columns) const
+{
+    columns.resize(plan.size(), count);
+
+    size_t valid = 0;
+    for (size_t row = 0; row < count; ++row)
+    {
+	bool good = frames[row].can_id == id && frames[row].len >= plan.length();
+	columns.valid_data[row] = good;
+	valid += good;
+    }
+
+    for (bool big : { false, true })
+    {
+	for (const DecodePlan::Step& step : plan.steps(big))
+	{
+	    if (avx2)
+		decodeAvx2(frames, count, step, big, columns);
+	    else
+		decodeScalar(frames, count, step, big, columns);
+	}
+    }
+
+    for (const DecodePlan::GenericSignal& signal : plan.genericSignals())
+    {
+	const DbcSignal& definition = signal.second;
+	long long *raw = columns.raw_data.data() + signal.first * columns.capacity;
+	double *values = columns.value_data.data() + signal.first * columns.capacity;
+	for (size_t row = 0; row < count; ++row)
+	{
+	    raw[row] = DecodePlan::genericValue(definition, frames[row].data);
+	    values[row] = (definition.is_signed ? (double)raw[row] : (double)(unsigned long long)raw[row])
+		* definition.factor + definition.offset;
+	}
+    }
+    return valid;
+}
+
+void BatchDecoder::decodeScalar(const canfd_frame *frames, size_t count, const DecodePlan::Step& step, bool big, SignalColumns& columns) const
+{
+    long long *raw = columns.raw_data.data() + step.index * columns.capacity;
+    double *values = columns.value_data.data() + step.index * columns.capacity;
+    for (size_t row = 0; row < count; ++row)
+    {
+	raw[row] = DecodePlan::stepValue(frames[row].data, step, big);
+	values[row] = raw[row] * step.factor + step.offset;
+    }
+}
+
+#ifdef BATCH_DECODER_AVX2
+__attribute__((target("avx2")))
+void BatchDecoder::decodeAvx2(const canfd_frame *frames, size_t count, const DecodePlan::Step& step, bool big, SignalColumns& columns) const
+{
+    long long *raw = columns.raw_data.data() + step.index * columns.capacity;
+    double *values = columns.value_data.data() + step.index * columns.capacity;
+
+    const __m256i stride = _mm256_setr_epi64x(0, sizeof(canfd_frame), 2 * sizeof(canfd_frame), 3 * sizeof(canfd_frame));
+    const __m256i swap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+					  7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i shift = _mm256_set1_epi64x(step.shift);
+    const __m256i mask = _mm256_set1_epi64x(step.mask);
+    // (x ^ s) - s sign extends from the bit s, AVX2 has no 64 bit arithmetic shift
+    int length = 64 - __builtin_clzll(step.mask);
+    const __m256i sign = _mm256_set1_epi64x(step.sign_shift ? 1ULL << (length - 1) : 0);
+    /*
+       Integers below 2^51 in magnitude become doubles by adding them to the mantissa of
+       1.5 * 2^52 and subtracting that again, AVX2 has no 64 bit integer conversion either.
+    */
+    const bool exact = length <= 51;
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    const __m256d factor = _mm256_set1_pd(step.factor);
+    const __m256d offset = _mm256_set1_pd(step.offset);
+
+    size_t row = 0;
+    for (; row + 4 <= count; row += 4)
+    {
+	__m256i word = _mm256_i64gather_epi64((const long long *)(frames[row].data + step.byte), stride, 1);
+	if (big)
+	    word = _mm256_shuffle_epi8(word, swap);
+	__m256i value = _mm256_and_si256(_mm256_srlv_epi64(word, shift), mask);
+	value = _mm256_sub_epi64(_mm256_xor_si256(value, sign), sign);
+	_mm256_storeu_si256((__m256i *)(raw + row), value);
+
+	if (exact)
+	{
+	    __m256d physical = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(value, _mm256_castpd_si256(magic))), magic);
+	    _mm256_storeu_pd(values + row, _mm256_add_pd(_mm256_mul_pd(physical, factor), offset));
+	}
+	else
+	{
+	    for (size_t i = row; i < row + 4; ++i)
+	    {
+		values[i] = raw[i] * step.factor + step.offset;
+	    }
+	}
+    }
+    for (; row < count; ++row)
+    {
+	raw[row] = DecodePlan::stepValue(frames[row].data, step, big);
+	values[row] = raw[row] * step.factor + step.offset;
+    }
+}
+#else
+void BatchDecoder::decodeAvx2(const canfd_frame *frames, size_t count, const DecodePlan::Step& step, bool big, SignalColumns& columns) const
+{
+    decodeScalar(frames, count, step, big, columns);
+}
+#endif
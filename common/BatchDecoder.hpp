@@ -0,0 +1,84 @@
+/*
+   Columnar batch signal decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef BATCH_DECODER_HPP
+#define BATCH_DECODER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <linux/can.h>
+
+#include "DecodePlan.hpp"
+#include "SignalDatabase.hpp"
+#include "VehicleMessage.hpp"
+
+/*
+   Decoded signals of a batch of frames, one column per signal.
+
+   raw(signal) holds the sign extended raw values and values(signal) the physical ones, each
+   contiguous over the rows, valid() marks the rows whose frame had the message id and a
+   payload long enough for the signals. Rows of invalid frames hold meaningless values.
+*/
+class SignalColumns
+{
+private:
+    friend class BatchDecoder;
+
+    size_t signal_count;
+    size_t row_count;
+    size_t capacity;
+    std::vector<long long> raw_data;
+    std::vector<double> value_data;
+    std::vector<unsigned char> valid_data;
+
+    void resize(size_t signals, size_t rows);
+public:
+    SignalColumns() : signal_count(0), row_count(0), capacity(0) {}
+
+    size_t signals() const { return signal_count; }
+    size_t rows() const { return row_count; }
+
+    const long long* raw(size_t signal) const { return raw_data.data() + signal * capacity; }
+    const double* values(size_t signal) const { return value_data.data() + signal * capacity; }
+    const unsigned char* valid() const { return valid_data.data(); }
+};
+
+/*
+   Decodes many frames of one message at once, column by column.
+
+   The message is compiled into a DecodePlan and every step of it is run over the whole
+   batch before the next one, so the loads, shifts, masks, sign extension and scaling of
+   one signal are the same instructions for every row. With AVX2 four frames are handled
+   per instruction: the 64 bit words are gathered from the frames, byte swapped for
+   Motorola signals, isolated and sign extended in 64 bit lanes and converted to double
+   without leaving the vector registers. The AVX2 code is compiled with a target attribute
+   and only used when the CPU supports it, otherwise (or on request) the same columns
+   are produced by scalar code. Only the signals a message always carries are decoded,
+   the columns of multiplexed signals are left undefined.
+*/
+class BatchDecoder
+{
+private:
+    DecodePlan plan;
+    canid_t id;
+    bool avx2;
+
+    void decodeScalar(const canfd_frame *frames, size_t count, const DecodePlan::Step& step, bool big, SignalColumns& columns) const;
+    void decodeAvx2(const canfd_frame *frames, size_t count, const DecodePlan::Step& step, bool big, SignalColumns& columns) const;
+public:
+    // vectorized false forces the scalar code
+    explicit BatchDecoder(const DbcMessage& message, bool vectorized = true);
+    // one of the configured vehicle messages, in the layout vehicleMessage() gives it
+    BatchDecoder(const MessageLayout& layout, VehicleSignal signal, bool vectorized = true);
+
+    // decode count frames into columns, returns the number of valid rows
+    size_t decode(const canfd_frame *frames, size_t count, SignalColumns& columns) const;
+
+    const char* name() const { return avx2 ? "avx2" : "scalar"; }
+    size_t signals() const { return plan.size(); }
+};
+
+#endif
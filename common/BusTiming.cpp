@@ -0,0 +1,239 @@
+/*
+   CAN bus bit timing and pacing for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "BusTiming.hpp"
+
+#include <ctime>
+
+#include "can.hpp"
+
+// CRC delimiter, ACK slot, ACK delimiter, end of frame and interframe space
+static constexpr unsigned frame_trailer_bits = 1 + 1 + 1 + 7 + 3;
+static constexpr long long nanoseconds_per_second = 1000000000LL;
+
+namespace
+{
+    // frame bits up to the end of the stuffed region, stuff bits are counted as they are added
+    class BitStream
+    {
+    private:
+	unsigned char bits[640];
+	unsigned length;
+	unsigned run;
+	unsigned char previous;
+    public:
+	unsigned stuff_bits;
+
+	BitStream() : length(0), run(0), previous(2), stuff_bits(0) {}
+
+	void append(unsigned value, unsigned width)
+	{
+	    for (unsigned i = width; i > 0; --i)
+	    {
+		bits[length++] = (value >> (i - 1)) & 1;
+	    }
+	}
+
+	unsigned size() const { return length; }
+
+	// CRC15 of classic CAN, over the unstuffed bits
+	unsigned crc15() const
+	{
+	    unsigned crc = 0;
+	    for (unsigned i = 0; i < length; ++i)
+	    {
+		unsigned next = bits[i] ^ ((crc >> 14) & 1);
+		crc = (crc << 1) & 0x7fff;
+		if (next)
+		    crc ^= 0x4599;
+	    }
+	    return crc;
+	}
+
+	// stuff bits in [from, to), a stuff bit starts the next run of equal bits
+	unsigned stuff(unsigned from, unsigned to)
+	{
+	    unsigned added = 0;
+	    for (unsigned i = from; i < to; ++i)
+	    {
+		if (bits[i] == previous)
+		{
+		    ++run;
+		}
+		else
+		{
+		    previous = bits[i];
+		    run = 1;
+		}
+		if (run == 5)
+		{
+		    ++added;
+		    previous ^= 1;
+		    run = 1;
+		}
+	    }
+	    return added;
+	}
+    };
+}
+
+BusTiming::BusTiming(unsigned bitrate, unsigned data_bitrate, Stuffing stuffing)
+    : bitrate(bitrate ? bitrate : 1), data_bitrate(data_bitrate ? data_bitrate : this->bitrate), stuffing(stuffing)
+{
+}
+
+bool BusTiming::parseStuffing(const std::string& name, Stuffing& stuffing)
+{
+    if (name == "exact")
+	stuffing = Stuffing::Exact;
+    else if (name == "worst-case")
+	stuffing = Stuffing::WorstCase;
+    else
+	return false;
+    return true;
+}
+
+BusTiming::Bits BusTiming::frameBits(const canfd_frame& frame, int mtu, Stuffing stuffing)
+{
+    bool fd = mtu == CANFD_MTU;
+    bool extended = frame.can_id & CAN_EFF_FLAG;
+    bool remote = !fd && (frame.can_id & CAN_RTR_FLAG);
+    unsigned dlc = fd ? CanMessage::fdDlc(frame.len) : (frame.len > CAN_MAX_DLEN ? CAN_MAX_DLEN : frame.len);
+    // FD payloads are padded up to the next length a DLC can express
+    unsigned length = remote ? 0 : (fd ? CanMessage::fdLength(dlc) : dlc);
+
+    BitStream stream;
+    stream.append(0, 1);
+    if (extended)
+    {
+	canid_t id = frame.can_id & CAN_EFF_MASK;
+	stream.append(id >> 18, 11);
+	stream.append(1, 1);                  // SRR
+	stream.append(1, 1);                  // IDE
+	stream.append(id & 0x3ffff, 18);
+    }
+    else
+    {
+	stream.append(frame.can_id & CAN_SFF_MASK, 11);
+    }
+    if (fd)
+    {
+	stream.append(0, 1);                  // RRS
+	if (!extended)
+	    stream.append(0, 1);              // IDE
+	stream.append(1, 1);                  // FDF
+	stream.append(0, 1);                  // res
+	stream.append((frame.flags & CANFD_BRS) ? 1 : 0, 1);
+    }
+    else
+    {
+	stream.append(remote ? 1 : 0, 1);     // RTR
+	stream.append(0, 2);                  // IDE r0, or r1 r0
+    }
+
+    // everything after BRS goes at the data bitrate
+    unsigned arbitration = stream.size();
+    if (fd)
+	stream.append((frame.flags & CANFD_ESI) ? 1 : 0, 1);
+    stream.append(dlc, 4);
+    for (unsigned i = 0; i < length; ++i)
+    {
+	stream.append(i < frame.len ? frame.data[i] : 0, 8);
+    }
+
+    Bits bits;
+    if (!fd)
+    {
+	unsigned stuffed = stream.size() + 15;
+	unsigned stuff_bits;
+	if (stuffing == Stuffing::Exact)
+	{
+	    stream.append(stream.crc15(), 15);
+	    stuff_bits = stream.stuff(0, stream.size());
+	}
+	else
+	{
+	    stuff_bits = (stuffed - 1) / 4;
+	}
+	bits.nominal = stuffed + stuff_bits + frame_trailer_bits;
+	bits.data = 0;
+	return bits;
+    }
+
+    // stuff count and CRC, with a fixed stuff bit ahead of every four bits
+    unsigned crc_field = 4 + (length > 16 ? 21 : 17);
+    crc_field += (crc_field + 3) / 4;
+
+    unsigned arbitration_stuff, data_stuff;
+    if (stuffing == Stuffing::Exact)
+    {
+	arbitration_stuff = stream.stuff(0, arbitration);
+	data_stuff = stream.stuff(arbitration, stream.size());
+    }
+    else
+    {
+	arbitration_stuff = (arbitration - 1) / 4;
+	data_stuff = (stream.size() - arbitration) / 4;
+    }
+
+    unsigned data_phase = stream.size() - arbitration + data_stuff + crc_field + 1;
+    bits.nominal = arbitration + arbitration_stuff + frame_trailer_bits - 1;
+    bits.data = 0;
+    if (frame.flags & CANFD_BRS)
+	bits.data = data_phase;
+    else
+	bits.nominal += data_phase;
+    return bits;
+}
+
+long long BusTiming::frameTime(const canfd_frame& frame, int mtu) const
+{
+    Bits bits = frameBits(frame, mtu, stuffing);
+    return bits.nominal * nanoseconds_per_second / bitrate + bits.data * nanoseconds_per_second / data_bitrate;
+}
+
+BusPacer::BusPacer(const BusTiming& timing)
+    : timing(timing), busy_total(0), frames(0)
+{
+    started = now();
+    busy_until = started;
+    last_report = started;
+    last_busy_total = 0;
+}
+
+long long BusPacer::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * nanoseconds_per_second + ts.tv_nsec;
+}
+
+bool BusPacer::ready() const
+{
+    return busy_until <= now();
+}
+
+void BusPacer::transmit(const canfd_frame& frame, int mtu, long long queued)
+{
+    // a frame that was already waiting starts right when the bus became idle, however late we woke up
+    long long start = queued;
+    if (start < busy_until)
+	start = busy_until;
+    long long duration = timing.frameTime(frame, mtu);
+    busy_until = start + duration;
+    busy_total += duration;
+    ++frames;
+}
+
+void BusPacer::printStatistics(std::ostream& out)
+{
+    long long current = now();
+    double load = current > last_report ? 100.0 * (busy_total - last_busy_total) / (current - last_report) : 0.0;
+    double average = current > started ? 100.0 * busy_total / (current - started) : 0.0;
+    out << "Bus " << timing.nominalBitrate() / 1000 << " kbit/s: " << frames << " frames, load "
+	<< load << " %, average " << average << " %" << std::endl;
+    last_report = current;
+    last_busy_total = busy_total;
+}
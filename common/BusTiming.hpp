@@ -0,0 +1,93 @@
+/*
+   CAN bus bit timing and pacing for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef BUS_TIMING_HPP
+#define BUS_TIMING_HPP
+
+#include <ostream>
+#include <string>
+
+#include <linux/can.h>
+
+/*
+   On-wire length of CAN and CAN FD frames.
+
+   A frame is counted from the start of frame bit to the end of the interframe space.
+   Bit stuffing is either exact (the frame is laid out bit by bit, with the CRC15 of
+   classic frames, and every stuff bit is counted) or worst case (one stuff bit per four
+   stuffable bits). CAN FD frames switch to the data bitrate from the BRS bit up to the
+   CRC delimiter when BRS is set. Their CRC field uses fixed stuff bits, so its length
+   does not depend on the CRC value.
+*/
+class BusTiming
+{
+public:
+    enum class Stuffing
+    {
+	Exact,
+	WorstCase
+    };
+
+    // bits sent at the nominal and at the data bitrate
+    struct Bits
+    {
+	unsigned nominal;
+	unsigned data;
+    };
+private:
+    unsigned bitrate;
+    unsigned data_bitrate;
+    Stuffing stuffing;
+public:
+    BusTiming(unsigned bitrate, unsigned data_bitrate, Stuffing stuffing);
+
+    // parse "exact" or "worst-case", returns false for anything else
+    static bool parseStuffing(const std::string& name, Stuffing& stuffing);
+
+    // length of the frame on the wire, mtu tells classic (CAN_MTU) and FD (CANFD_MTU) frames apart
+    static Bits frameBits(const canfd_frame& frame, int mtu, Stuffing stuffing);
+    // time the frame occupies the bus, in nanoseconds
+    long long frameTime(const canfd_frame& frame, int mtu) const;
+
+    unsigned nominalBitrate() const { return bitrate; }
+};
+
+/*
+   Releases frames no faster than a simulated bus could carry them.
+
+   The pacer keeps the time at which the simulated bus becomes idle again. A frame may
+   go out once the bus is idle, and then occupies it for its on-wire time from the moment
+   it was queued or the bus became idle, whichever is later. A burst is thus spread over
+   the time the bus needs for it, without late wakeups leaving gaps on the timeline. Busy
+   time is accumulated, which gives the busload over the whole run and since the previous
+   report.
+*/
+class BusPacer
+{
+private:
+    BusTiming timing;
+    long long busy_until;     // CLOCK_MONOTONIC nanoseconds
+    long long busy_total;     // nanoseconds
+    long long started;
+    long long last_report;
+    long long last_busy_total;
+    unsigned long long frames;
+public:
+    explicit BusPacer(const BusTiming& timing);
+
+    // true if the simulated bus is idle, so the next frame may go out now
+    bool ready() const;
+    // account for a frame that has just been released, queued is the time it became ready to go
+    void transmit(const canfd_frame& frame, int mtu, long long queued);
+    // CLOCK_MONOTONIC time (in nanoseconds) at which the bus becomes idle
+    long long idleAt() const { return busy_until; }
+
+    // busload since the previous call and since the start
+    void printStatistics(std::ostream& out);
+
+    static long long now();
+};
+
+#endif
@@ -4,16 +4,20 @@
 */
 
 #include "ConfigurationParser.hpp"
+#include "BusTiming.hpp"
+#include "TrafficGenerator.hpp"
+#include "TxQueue.hpp"
 
 #include <fstream>
 #include <iostream>
+#include <utility>
 
 ConfigurationParser::ConfigurationParser(std::string file_path)
 {
     this->configuration_file = file_path;
 }
 
-bool ConfigurationParser::parse()
+std::optional<SimulationConfig> ConfigurationParser::parse()
 {
     /*
        Before we even attempt reading data, we need to check the following:
@@ -29,7 +33,7 @@ bool ConfigurationParser::parse()
         if (!std::filesystem::exists(this->configuration_file))
         {
             std::cerr << "Error: configuration file does not exist." << std::endl;
-            return false;
+            return std::nullopt;
         }
         if (std::filesystem::is_symlink(this->configuration_file))
         {
@@ -38,24 +42,24 @@ bool ConfigurationParser::parse()
             if (!std::filesystem::exists(this->configuration_file))
             {
                 std::cerr << "Error: configuration file is a symlink resolving to non-existing path." << std::endl;
-                return false;
+                return std::nullopt;
             }
         }
         if (!std::filesystem::is_regular_file(this->configuration_file))
         {
             std::cerr << "Error: configuration file is not a regular file." << std::endl;
-            return false;
+            return std::nullopt;
         }
         if (std::filesystem::is_empty(this->configuration_file))
         {
             std::cerr << "Error: configuration file is empty." << std::endl;
-            return false;
+            return std::nullopt;
         }
     }
     catch (const std::filesystem::filesystem_error& error)
     {
         std::cerr << "Error (" << error.code() << ") while validating configuration file path: " << error.what() << std::endl;
-        return false;
+        return std::nullopt;
     }
 
     std::ifstream config_file(this->configuration_file);
@@ -67,19 +71,20 @@ bool ConfigurationParser::parse()
     catch (const nlohmann::json::parse_error& error)
     {
         std::cerr << "Error: could not parse JSON. Parse error: " << error.what() << std::endl;
-        return false;
+        return std::nullopt;
     }
     catch (const nlohmann::json::type_error& error)
     {
         std::cerr << "Error: invalid type encountered in JSON. Parse error: " << error.what() << std::endl;
-        return false;
+        return std::nullopt;
     }
     catch(const std::exception& ex)
     {
         std::cerr << "Error: some unknown error occurred. Parse error: " << ex.what() << std::endl;
-        return false;
+        return std::nullopt;
     }
 
+    SimulationConfig config;
     nlohmann::json car_parameters;
     nlohmann::json canbus_message_parameters;
 
@@ -90,7 +95,7 @@ bool ConfigurationParser::parse()
     else
     {
 	std::cerr << "Error: Car parameters are missing from configuration file" << std::endl;
-	return false;
+	return std::nullopt;
     }
 
     if (config_data.contains("canbus"))
@@ -100,33 +105,33 @@ bool ConfigurationParser::parse()
     else
     {
 	std::cerr << "Error: CAN message parameters are missing from configuration file" << std::endl;
-	return false;
+	return std::nullopt;
     }
 
     // parse car related configuration
     if (car_parameters.contains("maximum_speed"))
     {
-	CarParameters::MaximumSpeed = car_parameters["maximum_speed"].get<float>();
+	config.car.maximum_speed = car_parameters["maximum_speed"].get<float>();
     }
     if (car_parameters.contains("acceleration"))
     {
-	CarParameters::AccelerationRate = car_parameters["acceleration"].get<float>();
+	config.car.acceleration_rate = car_parameters["acceleration"].get<float>();
     }
     if (car_parameters.contains("door_lock"))
     {
-	Car::Status::Door::Locked = car_parameters["door_lock"].get<int>();
+	config.car.door_locked = car_parameters["door_lock"].get<int>();
     }
     if (car_parameters.contains("door_unlock"))
     {
-	Car::Status::Door::Unlocked = car_parameters["door_unlock"].get<int>();
+	config.car.door_unlocked = car_parameters["door_unlock"].get<int>();
     }
     if (car_parameters.contains("turn_signal_enable"))
     {
-	Car::Status::TurnSignal::On = car_parameters["turn_signal_enable"].get<int>();
+	config.car.turn_signal_on = car_parameters["turn_signal_enable"].get<int>();
     }
     if (car_parameters.contains("turn_signal_disable"))
     {
-	Car::Status::TurnSignal::Off = car_parameters["turn_signal_disable"].get<int>();
+	config.car.turn_signal_off = car_parameters["turn_signal_disable"].get<int>();
     }
 
     // parse canbus message related configuration
@@ -135,15 +140,19 @@ bool ConfigurationParser::parse()
 	nlohmann::json can_id = canbus_message_parameters["id"];
 	if (can_id.contains("door"))
 	{
-	    CanMessage::ID::Door = can_id["door"].get<int>();
+	    config.messages.door.id = can_id["door"].get<int>();
 	}
 	if (can_id.contains("signal"))
 	{
-	    CanMessage::ID::Signal = can_id["signal"].get<int>();
+	    config.messages.signal.id = can_id["signal"].get<int>();
 	}
 	if (can_id.contains("speed"))
 	{
-	    CanMessage::ID::Speed = can_id["speed"].get<int>();
+	    config.messages.speed.id = can_id["speed"].get<int>();
+	}
+	if (can_id.contains("diagnostic"))
+	{
+	    config.messages.diagnostic.id = can_id["diagnostic"].get<int>();
 	}
     }
     if (canbus_message_parameters.contains("position"))
@@ -151,15 +160,15 @@ bool ConfigurationParser::parse()
         nlohmann::json can_position = canbus_message_parameters["position"];
         if (can_position.contains("door"))
         {
-            CanMessage::Position::Door = can_position["door"].get<int>();
+            config.messages.door.position = can_position["door"].get<int>();
         }
         if (can_position.contains("signal"))
         {
-            CanMessage::Position::Signal = can_position["signal"].get<int>();
+            config.messages.signal.position = can_position["signal"].get<int>();
         }
         if (can_position.contains("speed"))
         {
-            CanMessage::Position::Speed = can_position["speed"].get<int>();
+            config.messages.speed.position = can_position["speed"].get<int>();
         }
     }
     if (canbus_message_parameters.contains("length"))
@@ -167,45 +176,403 @@ bool ConfigurationParser::parse()
         nlohmann::json can_length = canbus_message_parameters["length"];
         if (can_length.contains("door"))
         {
-            CanMessage::Length::Door = CanMessage::Position::Door + can_length["door"].get<int>();
+            config.messages.door.length = config.messages.door.position + can_length["door"].get<int>();
         }
         if (can_length.contains("signal"))
         {
-            CanMessage::Length::Signal = CanMessage::Position::Signal + can_length["signal"].get<int>();
+            config.messages.signal.length = config.messages.signal.position + can_length["signal"].get<int>();
         }
         if (can_length.contains("speed"))
         {
-            CanMessage::Length::Speed = CanMessage::Position::Speed + can_length["speed"].get<int>();
+            config.messages.speed.length = config.messages.speed.position + can_length["speed"].get<int>();
         }
     }
+    if (canbus_message_parameters.contains("period"))
+    {
+	nlohmann::json can_period = canbus_message_parameters["period"];
+	if (can_period.contains("door"))
+	{
+	    config.messages.door.period = can_period["door"].get<int>();
+	}
+	if (can_period.contains("signal"))
+	{
+	    config.messages.signal.period = can_period["signal"].get<int>();
+	}
+	if (can_period.contains("speed"))
+	{
+	    config.messages.speed.period = can_period["speed"].get<int>();
+	}
+	if (can_period.contains("diagnostic"))
+	{
+	    config.messages.diagnostic.period = can_period["diagnostic"].get<int>();
+	}
+    }
+    if (canbus_message_parameters.contains("offset"))
+    {
+	nlohmann::json can_offset = canbus_message_parameters["offset"];
+	if (can_offset.contains("door"))
+	{
+	    config.messages.door.offset = can_offset["door"].get<int>();
+	}
+	if (can_offset.contains("signal"))
+	{
+	    config.messages.signal.offset = can_offset["signal"].get<int>();
+	}
+	if (can_offset.contains("speed"))
+	{
+	    config.messages.speed.offset = can_offset["speed"].get<int>();
+	}
+	if (can_offset.contains("diagnostic"))
+	{
+	    config.messages.diagnostic.offset = can_offset["diagnostic"].get<int>();
+	}
+    }
+    if (canbus_message_parameters.contains("fd"))
+    {
+	nlohmann::json can_fd = canbus_message_parameters["fd"];
+	if (can_fd.contains("door"))
+	{
+	    config.messages.door.fd = can_fd["door"].get<bool>();
+	}
+	if (can_fd.contains("signal"))
+	{
+	    config.messages.signal.fd = can_fd["signal"].get<bool>();
+	}
+	if (can_fd.contains("speed"))
+	{
+	    config.messages.speed.fd = can_fd["speed"].get<bool>();
+	}
+	if (can_fd.contains("diagnostic"))
+	{
+	    config.messages.diagnostic.fd = can_fd["diagnostic"].get<bool>();
+	}
+	if (can_fd.contains("brs"))
+	{
+	    config.messages.brs = can_fd["brs"].get<bool>();
+	}
+	if (can_fd.contains("esi"))
+	{
+	    config.messages.esi = can_fd["esi"].get<bool>();
+	}
+    }
+    if (canbus_message_parameters.contains("frame_length"))
+    {
+	nlohmann::json can_frame_length = canbus_message_parameters["frame_length"];
+	if (can_frame_length.contains("door"))
+	{
+	    config.messages.door.frame_length = can_frame_length["door"].get<int>();
+	}
+	if (can_frame_length.contains("signal"))
+	{
+	    config.messages.signal.frame_length = can_frame_length["signal"].get<int>();
+	}
+	if (can_frame_length.contains("speed"))
+	{
+	    config.messages.speed.frame_length = can_frame_length["speed"].get<int>();
+	}
+    }
+    if (canbus_message_parameters.contains("periodic"))
+    {
+	for (const nlohmann::json& can_periodic : canbus_message_parameters["periodic"])
+	{
+	    if (!can_periodic.contains("id") || !can_periodic.contains("period"))
+	    {
+		std::cerr << "Error: periodic CAN frames need an id and a period" << std::endl;
+		return std::nullopt;
+	    }
+
+	    PeriodicFrame frame;
+	    frame.id = can_periodic["id"].get<int>();
+	    frame.period = can_periodic["period"].get<int>();
+	    frame.offset = can_periodic.contains("offset") ? can_periodic["offset"].get<int>() : 0;
+	    if (frame.period < 0 || frame.offset < 0)
+	    {
+		std::cerr << "Error: period and offset of periodic CAN frame " << frame.id << " must not be negative" << std::endl;
+		return std::nullopt;
+	    }
+	    frame.length = can_periodic.contains("length") ? can_periodic["length"].get<int>() : 8;
+	    frame.fd = can_periodic.contains("fd") ? can_periodic["fd"].get<bool>() : false;
+	    frame.brs = can_periodic.contains("brs") ? can_periodic["brs"].get<bool>() : frame.fd;
+	    if (can_periodic.contains("data"))
+	    {
+		frame.data = can_periodic["data"].get<std::vector<unsigned char>>();
+	    }
+	    config.messages.periodic.push_back(frame);
+	}
+    }
     if (canbus_message_parameters.contains("message"))
     {
 	nlohmann::json can_message = canbus_message_parameters["message"];
 	if (can_message.contains("left_signal"))
 	{
-	    CanMessage::Equipment::LeftSignal = can_message["left_signal"].get<int>();
+	    config.equipment.left_signal = can_message["left_signal"].get<int>();
 	}
 	if (can_message.contains("right_signal"))
         {
-            CanMessage::Equipment::RightSignal = can_message["right_signal"].get<int>();
+            config.equipment.right_signal = can_message["right_signal"].get<int>();
         }
 	if (can_message.contains("door1"))
         {
-            CanMessage::Equipment::Door1 = can_message["door1"].get<int>();
+            config.equipment.door1 = can_message["door1"].get<int>();
         }
 	if (can_message.contains("door2"))
         {
-            CanMessage::Equipment::Door2 = can_message["door2"].get<int>();
+            config.equipment.door2 = can_message["door2"].get<int>();
         }
 	if (can_message.contains("door3"))
         {
-            CanMessage::Equipment::Door3 = can_message["door3"].get<int>();
+            config.equipment.door3 = can_message["door3"].get<int>();
         }
 	if (can_message.contains("door4"))
         {
-            CanMessage::Equipment::Door4 = can_message["door4"].get<int>();
+            config.equipment.door4 = can_message["door4"].get<int>();
         }
     }
 
-    return true;
+    // parse simulator runtime configuration, the whole section is optional
+    if (config_data.contains("simulator"))
+    {
+	nlohmann::json simulator_parameters = config_data["simulator"];
+	if (simulator_parameters.contains("statistics_interval"))
+	{
+	    config.statistics_interval = simulator_parameters["statistics_interval"].get<int>();
+	}
+	if (simulator_parameters.contains("io_backend"))
+	{
+	    config.io_backend = simulator_parameters["io_backend"].get<std::string>();
+	    if (config.io_backend != "uring" && config.io_backend != "epoll")
+	    {
+		std::cerr << "Error: io_backend must be uring or epoll" << std::endl;
+		return std::nullopt;
+	    }
+	}
+	if (simulator_parameters.contains("controller"))
+	{
+	    nlohmann::json controller_parameters = simulator_parameters["controller"];
+	    if (controller_parameters.contains("tx_batch_size"))
+	    {
+		config.controller.tx_batch_size = controller_parameters["tx_batch_size"].get<int>();
+	    }
+	    if (controller_parameters.contains("tx_flush_deadline"))
+	    {
+		config.controller.tx_flush_deadline = controller_parameters["tx_flush_deadline"].get<int>();
+	    }
+	    if (controller_parameters.contains("tick_resolution"))
+	    {
+		config.controller.tick_resolution = controller_parameters["tick_resolution"].get<int>();
+	    }
+	    if (controller_parameters.contains("tx_queue_size"))
+	    {
+		config.controller.tx_queue_size = controller_parameters["tx_queue_size"].get<int>();
+	    }
+	    if (controller_parameters.contains("tx_overflow"))
+	    {
+		config.controller.tx_overflow = controller_parameters["tx_overflow"].get<std::string>();
+		TxQueue::Overflow policy;
+		if (!TxQueue::parsePolicy(config.controller.tx_overflow, policy))
+		{
+		    std::cerr << "Error: tx_overflow must be drop-oldest, drop-newest or block" << std::endl;
+		    return std::nullopt;
+		}
+	    }
+	    if (controller_parameters.contains("bitrate"))
+	    {
+		config.controller.bitrate = controller_parameters["bitrate"].get<int>();
+	    }
+	    if (controller_parameters.contains("data_bitrate"))
+	    {
+		config.controller.data_bitrate = controller_parameters["data_bitrate"].get<int>();
+	    }
+	    if (controller_parameters.contains("bit_stuffing"))
+	    {
+		config.controller.bit_stuffing = controller_parameters["bit_stuffing"].get<std::string>();
+		BusTiming::Stuffing stuffing;
+		if (!BusTiming::parseStuffing(config.controller.bit_stuffing, stuffing))
+		{
+		    std::cerr << "Error: bit_stuffing must be exact or worst-case" << std::endl;
+		    return std::nullopt;
+		}
+	    }
+	    if (controller_parameters.contains("difficulty"))
+	    {
+		config.controller.difficulty = controller_parameters["difficulty"].get<int>();
+	    }
+	    if (controller_parameters.contains("seed"))
+	    {
+		config.controller.seed = controller_parameters["seed"].get<unsigned long long>();
+	    }
+	    if (controller_parameters.contains("noise_blocks"))
+	    {
+		config.controller.noise_blocks = controller_parameters["noise_blocks"].get<int>();
+	    }
+	    if (controller_parameters.contains("noise_block_size"))
+	    {
+		config.controller.noise_block_size = controller_parameters["noise_block_size"].get<int>();
+	    }
+	}
+	if (simulator_parameters.contains("console"))
+	{
+	    nlohmann::json console_parameters = simulator_parameters["console"];
+	    if (console_parameters.contains("capture"))
+	    {
+		config.console.capture = console_parameters["capture"].get<std::string>();
+		if (config.console.capture != "raw" && config.console.capture != "mmap")
+		{
+		    std::cerr << "Error: console capture must be raw or mmap" << std::endl;
+		    return std::nullopt;
+		}
+	    }
+	    if (console_parameters.contains("packet_block_size"))
+	    {
+		config.console.packet_block_size = console_parameters["packet_block_size"].get<int>();
+	    }
+	    if (console_parameters.contains("packet_blocks"))
+	    {
+		config.console.packet_blocks = console_parameters["packet_blocks"].get<int>();
+	    }
+	    if (console_parameters.contains("packet_block_timeout"))
+	    {
+		config.console.packet_block_timeout = console_parameters["packet_block_timeout"].get<int>();
+	    }
+	    if (console_parameters.contains("rx_batch_size"))
+	    {
+		config.console.rx_batch_size = console_parameters["rx_batch_size"].get<int>();
+	    }
+	    if (console_parameters.contains("kernel_filter"))
+	    {
+		config.console.kernel_filter = console_parameters["kernel_filter"].get<bool>();
+	    }
+	    if (console_parameters.contains("filters"))
+	    {
+		for (const nlohmann::json& filter : console_parameters["filters"])
+		{
+		    if (!filter.contains("id") || !filter.contains("mask"))
+		    {
+			std::cerr << "Error: console filters need an id and a mask" << std::endl;
+			return std::nullopt;
+		    }
+		    config.console.filters.push_back({ filter["id"].get<unsigned int>(), filter["mask"].get<unsigned int>() });
+		}
+	    }
+	    if (console_parameters.contains("join_filters"))
+	    {
+		config.console.join_filters = console_parameters["join_filters"].get<bool>();
+	    }
+	    if (console_parameters.contains("decoder_threads"))
+	    {
+		config.console.decoder_threads = console_parameters["decoder_threads"].get<int>();
+	    }
+	    if (console_parameters.contains("ring_size"))
+	    {
+		config.console.ring_size = console_parameters["ring_size"].get<int>();
+	    }
+	    if (console_parameters.contains("backpressure_timeout"))
+	    {
+		config.console.backpressure_timeout = console_parameters["backpressure_timeout"].get<int>();
+	    }
+	    if (console_parameters.contains("refresh_rate"))
+	    {
+		config.console.refresh_rate = console_parameters["refresh_rate"].get<int>();
+	    }
+	    if (console_parameters.contains("metrics_file"))
+	    {
+		config.console.metrics_file = console_parameters["metrics_file"].get<std::string>();
+	    }
+	    if (console_parameters.contains("dbc"))
+	    {
+		config.console.database = console_parameters["dbc"].get<std::string>();
+	    }
+	}
+	if (simulator_parameters.contains("generator"))
+	{
+	    nlohmann::json generator_parameters = simulator_parameters["generator"];
+	    if (generator_parameters.contains("enabled"))
+	    {
+		config.generator.enabled = generator_parameters["enabled"].get<bool>();
+	    }
+	    if (generator_parameters.contains("fps"))
+	    {
+		config.generator.fps = generator_parameters["fps"].get<int>();
+	    }
+	    if (generator_parameters.contains("busload"))
+	    {
+		config.generator.busload = generator_parameters["busload"].get<double>();
+	    }
+	    if (generator_parameters.contains("ids"))
+	    {
+		for (const nlohmann::json& id : generator_parameters["ids"])
+		{
+		    if (!id.contains("id"))
+		    {
+			std::cerr << "Error: generator ids need an id" << std::endl;
+			return std::nullopt;
+		    }
+		    config.generator.ids.push_back({ id["id"].get<unsigned int>(),
+								    id.contains("weight") ? id["weight"].get<unsigned int>() : 1 });
+		}
+	    }
+	    if (generator_parameters.contains("min_length"))
+	    {
+		config.generator.min_length = generator_parameters["min_length"].get<int>();
+	    }
+	    if (generator_parameters.contains("max_length"))
+	    {
+		config.generator.max_length = generator_parameters["max_length"].get<int>();
+	    }
+	    if (generator_parameters.contains("fd"))
+	    {
+		config.generator.fd = generator_parameters["fd"].get<bool>();
+	    }
+	    if (generator_parameters.contains("brs"))
+	    {
+		config.generator.brs = generator_parameters["brs"].get<bool>();
+	    }
+	    if (generator_parameters.contains("payload"))
+	    {
+		config.generator.payload = generator_parameters["payload"].get<std::string>();
+		TrafficGenerator::Payload payload;
+		if (!TrafficGenerator::parsePayload(config.generator.payload, payload))
+		{
+		    std::cerr << "Error: generator payload must be random, zero or counter" << std::endl;
+		    return std::nullopt;
+		}
+	    }
+	}
+    }
+
+    // the scheduler takes periods as whole ticks, 0 only disables the diagnostic frame
+    const std::pair<const char *, const MessageLayout *> scheduled[] = {
+	{ "door", &config.messages.door },
+	{ "signal", &config.messages.signal },
+	{ "speed", &config.messages.speed },
+	{ "diagnostic", &config.messages.diagnostic }
+    };
+    for (const auto& [name, message] : scheduled)
+    {
+	if (message->period < 0 || (!message->period && message != &config.messages.diagnostic))
+	{
+	    std::cerr << "Error: " << name << " period must be positive" << std::endl;
+	    return std::nullopt;
+	}
+	if (message->offset < 0)
+	{
+	    std::cerr << "Error: " << name << " offset must not be negative" << std::endl;
+	    return std::nullopt;
+	}
+	if (message->period && message->period * 1000LL < config.controller.tick_resolution)
+	{
+	    std::cerr << "Error: " << name << " period is shorter than the controller tick_resolution" << std::endl;
+	    return std::nullopt;
+	}
+    }
+    for (const PeriodicFrame& frame : config.messages.periodic)
+    {
+	if (frame.period && frame.period * 1000LL < config.controller.tick_resolution)
+	{
+	    std::cerr << "Error: period of periodic CAN frame " << frame.id << " is shorter than the controller tick_resolution" << std::endl;
+	    return std::nullopt;
+	}
+    }
+
+    return config;
 }
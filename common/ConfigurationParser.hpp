@@ -7,10 +7,10 @@
 #define CONFIGURATION_PARSER
 
 #include "../3rdparty/json.hpp"
-#include "car.hpp"
-#include "can.hpp"
+#include "SimulationConfig.hpp"
 
 #include <filesystem>
+#include <optional>
 #include <string>
 
 /*
@@ -42,7 +42,8 @@ private:
 protected:
 public:
     ConfigurationParser(std::string file_path = "./config.json");
-    bool parse();
+    // the configuration of the file over the defaults, nothing if the file is missing or invalid
+    std::optional<SimulationConfig> parse();
 };
 
 #endif
@@ -0,0 +1,160 @@
+/*
+   Cyclic scheduler for periodic CAN messages
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "CyclicScheduler.hpp"
+
+#include <cerrno>
+#include <ctime>
+
+static constexpr long long nanoseconds_per_second = 1000000000LL;
+
+CyclicScheduler::CyclicScheduler(std::chrono::nanoseconds resolution)
+{
+    this->resolution = resolution.count() > 0 ? resolution.count() : 1;
+    epoch = now();
+    wakeup = epoch;
+}
+
+long long CyclicScheduler::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * nanoseconds_per_second + ts.tv_nsec;
+}
+
+void CyclicScheduler::add(const std::string& name, std::chrono::nanoseconds period, std::chrono::nanoseconds offset, Task task)
+{
+    Entry entry;
+    entry.name = name;
+    entry.period = period.count() / resolution;
+    // the timeline starts at the first unprocessed tick, see start()
+    entry.next_release = wheel.now() + 1 + (offset.count() > 0 ? offset.count() / resolution : 0);
+    entry.task = std::move(task);
+    entry.statistics = {};
+    entries.push_back(std::move(entry));
+
+    size_t index = entries.size() - 1;
+    wheel.schedule(entries[index].next_release - wheel.now(), entries[index].period, index);
+}
+
+void CyclicScheduler::once(std::chrono::nanoseconds delay, Task task)
+{
+    size_t index;
+    if (!free_one_shots.empty())
+    {
+	index = free_one_shots.back();
+	free_one_shots.pop_back();
+	one_shots[index] = std::move(task);
+    }
+    else
+    {
+	index = one_shots.size();
+	one_shots.push_back(std::move(task));
+    }
+    wheel.schedule(delay.count() > 0 ? delay.count() / resolution : 0, 0, one_shot_tag | index);
+}
+
+void CyclicScheduler::start()
+{
+    // tick n of the wheel starts at epoch + n * resolution, the first unprocessed tick starts now
+    epoch = now() - (wheel.now() + 1) * resolution;
+}
+
+void CyclicScheduler::release(size_t index)
+{
+    Entry& entry = entries[index];
+    uint64_t tick = entry.next_release;
+    entry.next_release += entry.period;
+
+    long long jitter = wakeup - (epoch + (long long)tick * resolution);
+    if (jitter < 0)
+	jitter = 0;
+    if (jitter >= (long long)entry.period * resolution)
+    {
+	// the wheel replays every tick of a late wakeup, drop the releases that are a whole period late
+	++entry.statistics.missed_deadlines;
+	return;
+    }
+
+    ++entry.statistics.releases;
+    entry.statistics.total_jitter += jitter;
+    if (jitter > entry.statistics.max_jitter)
+	entry.statistics.max_jitter = jitter;
+
+    entry.task();
+}
+
+void CyclicScheduler::runOneShot(size_t index)
+{
+    // the task may schedule further one-shot tasks, which can grow one_shots
+    Task task = std::move(one_shots[index]);
+    one_shots[index] = nullptr;
+    free_one_shots.push_back(index);
+    task();
+}
+
+void CyclicScheduler::runOnce()
+{
+    if (!wheel.size())
+        return;
+
+    long long next = nextRelease();
+    timespec deadline;
+    deadline.tv_sec = next / nanoseconds_per_second;
+    deadline.tv_nsec = next % nanoseconds_per_second;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        ;
+
+    wakeup = now();
+    if (wakeup < epoch)
+	return;
+    wheel.advance((wakeup - epoch) / resolution, [this](uint64_t value)
+    {
+	if (value & one_shot_tag)
+	    runOneShot(value & ~one_shot_tag);
+	else
+	    release(value);
+    });
+}
+
+long long CyclicScheduler::nextRelease() const
+{
+    if (!wheel.size())
+	return -1;
+    return epoch + (long long)wheel.nextExpiry() * resolution;
+}
+
+void CyclicScheduler::printStatistics(std::ostream& out) const
+{
+    Statistics remaining = {};
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+	const Statistics& statistics = entries[i].statistics;
+	if (i >= listed_entries)
+	{
+	    remaining.releases += statistics.releases;
+	    remaining.missed_deadlines += statistics.missed_deadlines;
+	    remaining.total_jitter += statistics.total_jitter;
+	    if (statistics.max_jitter > remaining.max_jitter)
+		remaining.max_jitter = statistics.max_jitter;
+	    continue;
+	}
+
+        double average = statistics.releases ? (double)statistics.total_jitter / statistics.releases : 0.0;
+	out << "Schedule " << entries[i].name << ": period " << entries[i].period * resolution / 1000 << " us, "
+            << statistics.releases << " releases, "
+            << statistics.missed_deadlines << " missed deadlines, jitter avg "
+            << average / 1000.0 << " us, max " << statistics.max_jitter / 1000.0 << " us" << std::endl;
+    }
+
+    if (entries.size() > listed_entries)
+    {
+	double average = remaining.releases ? (double)remaining.total_jitter / remaining.releases : 0.0;
+	out << "Schedule (" << entries.size() - listed_entries << " more): "
+	    << remaining.releases << " releases, "
+	    << remaining.missed_deadlines << " missed deadlines, jitter avg "
+	    << average / 1000.0 << " us, max " << remaining.max_jitter / 1000.0 << " us" << std::endl;
+    }
+}
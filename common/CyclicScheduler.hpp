@@ -0,0 +1,89 @@
+/*
+   Cyclic scheduler for periodic CAN messages
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef CYCLIC_SCHEDULER_HPP
+#define CYCLIC_SCHEDULER_HPP
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "TimerWheel.hpp"
+
+/*
+   Releases periodic tasks on an absolute CLOCK_MONOTONIC timeline.
+
+   Every release time is computed as epoch + offset + n * period, never from the time the
+   previous release actually ran, so late wakeups show up as jitter instead of stretching
+   the period. A release that is a whole period (or more) late is counted as a missed
+   deadline and skipped, so the task stays phase aligned.
+
+   Releases are kept in a TimerWheel with a fixed tick resolution, so the cost of a wakeup
+   depends on the number of tasks that are due, not on the number of tasks registered.
+   Periods and offsets are rounded to whole ticks. One-shot tasks share the wheel with the
+   periodic ones.
+*/
+class CyclicScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    struct Statistics
+    {
+        unsigned long long releases;
+        unsigned long long missed_deadlines;
+        long long max_jitter;     // nanoseconds
+        long long total_jitter;   // nanoseconds
+    };
+private:
+    struct Entry
+    {
+        std::string name;
+	uint64_t period;          // ticks
+	uint64_t next_release;    // tick
+        Task task;
+        Statistics statistics;
+    };
+
+    // only this many tasks are listed one by one in printStatistics(), the rest are summarized
+    static constexpr size_t listed_entries = 16;
+
+    // wheel values with this bit set are one-shot tasks, the rest index entries
+    static constexpr uint64_t one_shot_tag = 1ULL << 63;
+
+    std::vector<Entry> entries;
+    std::vector<Task> one_shots;
+    std::vector<size_t> free_one_shots;
+    TimerWheel wheel;
+    long long resolution;
+    long long epoch;
+    long long wakeup;
+
+    void release(size_t index);
+    void runOneShot(size_t index);
+public:
+    explicit CyclicScheduler(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1));
+
+    // register a periodic task, period (at least one tick) and offset are relative to the scheduler epoch
+    void add(const std::string& name, std::chrono::nanoseconds period, std::chrono::nanoseconds offset, Task task);
+    // run task once, delay after the last processed tick
+    void once(std::chrono::nanoseconds delay, Task task);
+
+    // (re)start the timeline, the first release of every task happens at now + offset
+    void start();
+    // sleep until the earliest pending release and run every task that is due
+    void runOnce();
+    // CLOCK_MONOTONIC time (in nanoseconds) of the earliest pending release, -1 if there is none
+    long long nextRelease() const;
+
+    size_t size() const { return entries.size(); }
+    void printStatistics(std::ostream& out) const;
+
+    static long long now();
+};
+
+#endif
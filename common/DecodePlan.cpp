@@ -0,0 +1,75 @@
+/*
+   Compiled signal decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "DecodePlan.hpp"
+
+#include <linux/can.h>
+
+DecodePlan::DecodePlan()
+    : needed(0), count(0)
+{
+}
+
+DecodePlan::DecodePlan(const DbcMessage& message)
+    : needed(0), count(message.signals.size())
+{
+    for (size_t i = 0; i < message.signals.size(); ++i)
+    {
+	if (message.signals[i].multiplexing != DbcSignal::Multiplexed)
+	    compile(message.signals[i], i);
+    }
+}
+
+DecodePlan::DecodePlan(const DbcMessage& message, unsigned mux_value)
+    : needed(0), count(message.signals.size())
+{
+    for (size_t i = 0; i < message.signals.size(); ++i)
+    {
+	const DbcSignal& signal = message.signals[i];
+	if (signal.multiplexing == DbcSignal::Multiplexed && signal.mux_value == mux_value)
+	    compile(signal, i);
+    }
+}
+
+void DecodePlan::compile(const DbcSignal& signal, size_t index)
+{
+    int end = SignalDatabase::endByte(signal);
+    if (end > needed)
+	needed = end;
+
+    Step step;
+    step.index = index;
+    step.mask = signal.length == 64 ? ~0ULL : (1ULL << signal.length) - 1;
+    step.sign_shift = signal.is_signed ? 64 - signal.length : 0;
+    step.factor = signal.factor;
+    step.offset = signal.offset;
+
+    /*
+       The 64 bit window starts at the first byte of the signal, moved back so it never
+       reaches past the 64 byte payload buffer. The shift is then the number of window bits
+       below the least significant bit of the signal.
+    */
+    int byte = signal.start_bit / 8;
+    int back = byte > CANFD_MAX_DLEN - 8 ? byte - (CANFD_MAX_DLEN - 8) : 0;
+    int shift;
+    if (signal.big_endian)
+	shift = 57 + signal.start_bit % 8 - signal.length - 8 * back;
+    else
+	shift = signal.start_bit % 8 + 8 * back;
+
+    // 64 bit unsigned signals go the generic way too, so they are scaled as unsigned values
+    bool fits = shift >= 0 && shift + signal.length <= 64 && (signal.is_signed || signal.length < 64);
+    if (!fits)
+    {
+	generic.emplace_back(index, signal);
+	return;
+    }
+    step.byte = byte - back;
+    step.shift = shift;
+    if (signal.big_endian)
+	big_endian.push_back(step);
+    else
+	little_endian.push_back(step);
+}
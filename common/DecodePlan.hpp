@@ -0,0 +1,145 @@
+/*
+   Compiled signal decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef DECODE_PLAN_HPP
+#define DECODE_PLAN_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <endian.h>
+
+#include "SignalDatabase.hpp"
+
+/*
+   Decodes every signal of one message with steps compiled once at load time.
+
+   Each signal becomes a step holding the payload byte to load 64 bits from, the shift and
+   mask that isolate the signal in that word, the shift pair for sign extension and the
+   scaling to physical units. Intel and Motorola signals are kept apart, so decoding a
+   message is two branch free runs of load, shift, mask and scale instead of walking the
+   signal definitions bit by bit. Signals that no 64 bit window holds (long, unaligned ones)
+   fall back to SignalDatabase::rawValue().
+
+   Decoded values are stored by signal index, in the order of the message definition. A
+   plan covers either the signals a message always carries or the ones multiplexed under
+   one multiplexor value, MessageDecoder puts them together.
+*/
+class DecodePlan
+{
+public:
+    struct Step
+    {
+	uint8_t byte;
+	uint8_t shift;
+	uint8_t sign_shift;    // 64 - length for signed signals, 0 otherwise
+	uint16_t index;
+	uint64_t mask;
+	double factor;
+	double offset;
+    };
+    typedef std::pair<uint16_t, DbcSignal> GenericSignal;
+private:
+    std::vector<Step> little_endian;
+    std::vector<Step> big_endian;
+    std::vector<GenericSignal> generic;
+    int needed;                // payload bytes the signals occupy
+    size_t count;
+
+    void compile(const DbcSignal& signal, size_t index);
+
+    static long long extend(uint64_t raw, const Step& step)
+    {
+	return (long long)(raw << step.sign_shift) >> step.sign_shift;
+    }
+
+    static uint64_t load(const unsigned char *data, const Step& step, bool big)
+    {
+	uint64_t word;
+	memcpy(&word, data + step.byte, sizeof(word));
+	return big ? be64toh(word) : le64toh(word);
+    }
+public:
+    // raw value of one step, sign extended
+    static long long stepValue(const unsigned char *data, const Step& step, bool big)
+    {
+	return extend((load(data, step, big) >> step.shift) & step.mask, step);
+    }
+
+    // raw value of a signal no step holds, sign extended
+    static long long genericValue(const DbcSignal& signal, const unsigned char *data)
+    {
+	unsigned long long raw = SignalDatabase::rawValue(signal, data);
+	if (signal.is_signed && signal.length < 64)
+	    return (long long)(raw << (64 - signal.length)) >> (64 - signal.length);
+	return raw;
+    }
+
+    DecodePlan();
+    // the plain signals of a message and its multiplexor
+    explicit DecodePlan(const DbcMessage& message);
+    // the signals multiplexed under one value of the multiplexor
+    DecodePlan(const DbcMessage& message, unsigned mux_value);
+
+    /*
+       raw values, sign extended (64 bit unsigned ones wrap), into the slots of the compiled
+       signals in raw[0 .. size()). data is a full CAN FD payload buffer (64 bytes, as in
+       canfd_frame), length the bytes received. Returns false without decoding if the
+       payload is too short for the signals.
+    */
+    bool decodeRaw(const unsigned char *data, int length, long long *raw) const
+    {
+	if (length < needed)
+	    return false;
+	for (const Step& step : little_endian)
+	{
+	    raw[step.index] = stepValue(data, step, false);
+	}
+	for (const Step& step : big_endian)
+	{
+	    raw[step.index] = stepValue(data, step, true);
+	}
+	for (const auto& signal : generic)
+	{
+	    raw[signal.first] = genericValue(signal.second, data);
+	}
+	return true;
+    }
+
+    // the same, scaled to physical values (raw * factor + offset)
+    bool decode(const unsigned char *data, int length, double *values) const
+    {
+	if (length < needed)
+	    return false;
+	for (const Step& step : little_endian)
+	{
+	    values[step.index] = stepValue(data, step, false) * step.factor + step.offset;
+	}
+	for (const Step& step : big_endian)
+	{
+	    values[step.index] = stepValue(data, step, true) * step.factor + step.offset;
+	}
+	for (const auto& signal : generic)
+	{
+	    const DbcSignal& definition = signal.second;
+	    long long raw = genericValue(definition, data);
+	    values[signal.first] = (definition.is_signed ? (double)raw : (double)(unsigned long long)raw)
+		* definition.factor + definition.offset;
+	}
+	return true;
+    }
+
+    // the compiled signals, Intel or Motorola ones, and those decoded bit by bit
+    const std::vector<Step>& steps(bool big) const { return big ? big_endian : little_endian; }
+    const std::vector<GenericSignal>& genericSignals() const { return generic; }
+
+    // number of signals of the message, compiled or not
+    size_t size() const { return count; }
+    // payload bytes a frame needs for the signals to be decoded
+    int length() const { return needed; }
+};
+
+#endif
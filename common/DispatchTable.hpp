@@ -0,0 +1,144 @@
+/*
+   CAN id dispatch table for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef DISPATCH_TABLE_HPP
+#define DISPATCH_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linux/can.h>
+
+/*
+   Maps a received can_id straight to its handler.
+
+   Standard (11-bit) ids index a flat table of 2048 entries. Extended (29-bit) ids live in
+   a small open addressing hash table with linear probing, kept at most half full. Remote
+   and error frames never match. An id has one handler, owners that need several chain
+   them behind it. Handler is anything that can be value initialized to an empty state
+   and compared against it, e.g. a function or member function pointer.
+*/
+template <typename Handler>
+class DispatchTable
+{
+private:
+    static constexpr uint32_t empty_key = UINT32_MAX;
+
+    Handler standard[CAN_SFF_MASK + 1];
+
+    std::vector<uint32_t> extended_keys;
+    std::vector<Handler> extended_handlers;
+    size_t extended_count;
+    uint32_t extended_shift;
+
+    size_t slot(uint32_t id) const
+    {
+	// multiplicative hashing, the top bits of the product pick the slot
+	return (uint32_t)(id * 0x9e3779b1u) >> extended_shift;
+    }
+
+    void rehash(size_t capacity_bits)
+    {
+	std::vector<uint32_t> keys(extended_keys);
+	std::vector<Handler> handlers(extended_handlers);
+
+	extended_keys.assign((size_t)1 << capacity_bits, empty_key);
+	extended_handlers.assign((size_t)1 << capacity_bits, Handler());
+	extended_shift = 32 - capacity_bits;
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+	    if (keys[i] != empty_key)
+		insert(keys[i], handlers[i]);
+	}
+    }
+
+    bool insert(uint32_t id, Handler handler)
+    {
+	size_t mask = extended_keys.size() - 1;
+	for (size_t i = slot(id); ; i = (i + 1) & mask)
+	{
+	    if (extended_keys[i] == id)
+	    {
+		extended_handlers[i] = handler;
+		return false;
+	    }
+	    if (extended_keys[i] == empty_key)
+	    {
+		extended_keys[i] = id;
+		extended_handlers[i] = handler;
+		return true;
+	    }
+	}
+    }
+public:
+    DispatchTable()
+	: extended_count(0)
+    {
+	clear();
+    }
+
+    void clear()
+    {
+	for (size_t i = 0; i <= CAN_SFF_MASK; ++i)
+	    standard[i] = Handler();
+	extended_count = 0;
+	extended_keys.assign(16, empty_key);
+	extended_handlers.assign(16, Handler());
+	extended_shift = 32 - 4;
+    }
+
+    // register handler for can_id (CAN_EFF_FLAG set for extended ids), returns false if it replaced another one
+    bool add(canid_t can_id, Handler handler)
+    {
+	if (can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG))
+	    return false;
+
+	if (!(can_id & CAN_EFF_FLAG))
+	{
+	    bool taken = standard[can_id & CAN_SFF_MASK] != Handler();
+	    standard[can_id & CAN_SFF_MASK] = handler;
+	    return !taken;
+	}
+
+	if ((extended_count + 1) * 2 > extended_keys.size())
+	    rehash(32 - extended_shift + 1);
+	if (!insert(can_id & CAN_EFF_MASK, handler))
+	    return false;
+	++extended_count;
+	return true;
+    }
+
+    // handler for a received can_id, or an empty Handler when nothing is registered
+    Handler find(canid_t can_id) const
+    {
+	if (!(can_id & ~CAN_SFF_MASK))
+	    return standard[can_id];
+	if ((can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != CAN_EFF_FLAG)
+	    return Handler();
+
+	uint32_t id = can_id & CAN_EFF_MASK;
+	size_t mask = extended_keys.size() - 1;
+	for (size_t i = slot(id); extended_keys[i] != empty_key; i = (i + 1) & mask)
+	{
+	    if (extended_keys[i] == id)
+		return extended_handlers[i];
+	}
+	return Handler();
+    }
+
+    size_t size() const
+    {
+	size_t count = extended_count;
+	for (size_t i = 0; i <= CAN_SFF_MASK; ++i)
+	{
+	    if (standard[i] != Handler())
+		++count;
+	}
+	return count;
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+   epoll based CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "EpollEngine.hpp"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+EpollEngine::EpollEngine(int socket, size_t rx_depth, size_t tx_depth, std::chrono::microseconds deadline)
+    : IoEngine(socket), epoll_fd(-1), rx_batch(socket, rx_depth), tx_batch(socket, tx_depth, deadline), waits(0)
+{
+    batch = &rx_batch.received(0);
+}
+
+EpollEngine::~EpollEngine()
+{
+    if (epoll_fd >= 0)
+	close(epoll_fd);
+}
+
+bool EpollEngine::open()
+{
+    int flags = fcntl(can_socket, F_GETFL);
+    if (flags < 0 || fcntl(can_socket, F_SETFL, flags | O_NONBLOCK) < 0)
+	return false;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+	return false;
+
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.fd = can_socket;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, can_socket, &event) == 0;
+}
+
+bool EpollEngine::wait(int timeout)
+{
+    epoll_event event;
+    int count;
+    do
+    {
+	++waits;
+	count = epoll_wait(epoll_fd, &event, 1, timeout);
+    } while (count < 0 && errno == EINTR);
+    return count >= 0;
+}
+
+bool EpollEngine::queue(const canfd_frame& frame, int mtu)
+{
+    return tx_batch.queue(frame, mtu);
+}
+
+bool EpollEngine::flush()
+{
+    return tx_batch.flush();
+}
+
+bool EpollEngine::waitWritable(std::chrono::microseconds timeout)
+{
+    return wait((timeout.count() + 999) / 1000);
+}
+
+int EpollEngine::receive()
+{
+    while (true)
+    {
+	int count = rx_batch.receive();
+	if (count >= 0)
+	{
+	    kernel_drops = rx_batch.kernelDrops();
+	    return count;
+	}
+	if (errno != EAGAIN && errno != EWOULDBLOCK)
+	    return -1;
+	if (!wait(-1))
+	    return -1;
+    }
+}
@@ -0,0 +1,50 @@
+/*
+   epoll based CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef EPOLL_ENGINE_HPP
+#define EPOLL_ENGINE_HPP
+
+#include "IoEngine.hpp"
+#include "RxBatch.hpp"
+#include "TxBatch.hpp"
+
+/*
+   Fallback backend: the socket is switched to non-blocking mode, frames move with
+   sendmmsg()/recvmmsg() (through TxBatch and RxBatch) and the engine only sleeps in
+   epoll_wait() after the kernel answered EAGAIN, on receive() or in waitWritable(). The
+   socket is registered edge triggered for both directions, so a wake up for the other
+   direction just costs one retry.
+*/
+class EpollEngine : public IoEngine
+{
+private:
+    int epoll_fd;
+    RxBatch rx_batch;
+    TxBatch tx_batch;
+    unsigned long long waits;
+
+    // returns false on error, a timeout (in milliseconds, -1 for none) is not an error
+    bool wait(int timeout);
+public:
+    EpollEngine(int socket, size_t rx_depth, size_t tx_depth, std::chrono::microseconds deadline);
+    ~EpollEngine();
+
+    // switch the socket to non-blocking mode and register it, returns false on error
+    bool open();
+
+    const char* name() const { return "epoll"; }
+
+    bool queue(const canfd_frame& frame, int mtu);
+    bool flush();
+    int receive();
+    size_t pending() const { return tx_batch.size(); }
+    bool waitWritable(std::chrono::microseconds timeout);
+
+    unsigned long long framesSent() const { return tx_batch.framesSent(); }
+    unsigned long long framesReceived() const { return rx_batch.framesReceived(); }
+    unsigned long long syscallCount() const { return tx_batch.syscallCount() + rx_batch.syscallCount() + waits; }
+};
+
+#endif
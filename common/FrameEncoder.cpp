@@ -0,0 +1,59 @@
+/*
+   Precompiled CAN frame encoders for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "FrameEncoder.hpp"
+
+#include <algorithm>
+
+#include "can.hpp"
+
+FrameEncoder::FrameEncoder()
+    : FrameEncoder(0, 0, false, false, false)
+{
+}
+
+FrameEncoder::FrameEncoder(canid_t id, int length, bool fd, bool brs, bool esi)
+{
+    memset(&frame_template, 0, sizeof(frame_template));
+    frame_template.can_id = id;
+    length = std::max(length, 0);
+    if (!fd)
+    {
+	frame_template.len = std::min(length, CAN_MAX_DLEN);
+	mtu = CAN_MTU;
+	return;
+    }
+
+    frame_template.len = CanMessage::fdLength(CanMessage::fdDlc(std::min(length, CANFD_MAX_DLEN)));
+    frame_template.flags = CANFD_FDF;
+    if (brs)
+	frame_template.flags |= CANFD_BRS;
+    if (esi)
+	frame_template.flags |= CANFD_ESI;
+    mtu = CANFD_MTU;
+}
+
+void FrameEncoder::setData(const std::vector<unsigned char>& data)
+{
+    size_t count = std::min(data.size(), (size_t)frame_template.len);
+    memcpy(frame_template.data, data.data(), count);
+}
+
+void FrameEncoder::addField(int position, int width, bool big_endian)
+{
+    width = std::min(std::max(width, 0), 8);
+    int stored = std::min(width, (int)frame_template.len - position);
+    if (position < 0 || stored < 0)
+	stored = 0;
+    fields.push_back({ position, width, stored, big_endian });
+}
+
+void FrameEncoder::addFiller(int start, int stop)
+{
+    start = std::max(start, 0);
+    stop = std::min(stop, (int)frame_template.len);
+    if (start < stop)
+	filler.push_back({ start, stop });
+}
@@ -0,0 +1,92 @@
+/*
+   Precompiled CAN frame encoders for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef FRAME_ENCODER_HPP
+#define FRAME_ENCODER_HPP
+
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#include <linux/can.h>
+
+/*
+   Builds the frames of one message from a layout compiled once at startup.
+
+   The encoder keeps a template frame with the identifier, flags, length and constant
+   bytes already in place, so encoding is one copy of the frame (16 bytes for classic
+   frames, 72 for CAN FD) followed by a store per signal field. Fields are unsigned
+   integers of 1 to 8 bytes in either byte order. Filler ranges are only recorded, the
+   owner decides whether and how they are randomized.
+*/
+class FrameEncoder
+{
+public:
+    struct Span
+    {
+	int start;
+	int stop;
+    };
+private:
+    struct Field
+    {
+	int position;
+	int width;
+	int stored;           // bytes of the field inside the payload
+	bool big_endian;
+    };
+
+    canfd_frame frame_template;
+    int mtu;
+    std::vector<Field> fields;
+    std::vector<Span> filler;
+public:
+    FrameEncoder();
+    /*
+       start a layout. length is the payload length, FD frames are rounded up to the next
+       valid FD length and classic ones capped at 8.
+    */
+    FrameEncoder(canid_t id, int length, bool fd, bool brs, bool esi);
+
+    // constant payload bytes, beyond the payload length they are ignored
+    void setData(const std::vector<unsigned char>& data);
+    // signal fields, encode() takes their values in the order they were added, bytes beyond the payload are dropped
+    void addField(int position, int width, bool big_endian);
+    // bytes [start, stop) the owner may randomize, clipped to the payload
+    void addFiller(int start, int stop);
+
+    // copy the template into frame, for callers storing the fields themselves. Returns the MTU to send with
+    int copy(canfd_frame& frame) const
+    {
+	// constant sizes, so the copy is a few inline moves instead of a memcpy() call
+	if (mtu == CAN_MTU)
+	    memcpy(&frame, &frame_template, CAN_MTU);
+	else
+	    memcpy(&frame, &frame_template, CANFD_MTU);
+	return mtu;
+    }
+
+    // copy the template into frame and store the field values, returns the MTU to send with
+    int encode(canfd_frame& frame, std::initializer_list<unsigned long long> values) const
+    {
+	copy(frame);
+	const unsigned long long *value = values.begin();
+	for (const Field& field : fields)
+	{
+	    unsigned long long bits = value < values.end() ? *value++ : 0;
+	    for (int i = 0; i < field.stored; ++i)
+	    {
+		int shift = 8 * (field.big_endian ? field.width - 1 - i : i);
+		frame.data[field.position + i] = (bits >> shift) & 0xff;
+	    }
+	}
+	return mtu;
+    }
+
+    const std::vector<Span>& fillers() const { return filler; }
+    int length() const { return frame_template.len; }
+};
+
+#endif
@@ -0,0 +1,25 @@
+/*
+   Asynchronous CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "IoEngine.hpp"
+#include "EpollEngine.hpp"
+#include "UringEngine.hpp"
+
+std::unique_ptr<IoEngine> IoEngine::create(const std::string& backend, int socket,
+					   size_t rx_depth, size_t tx_depth,
+					   std::chrono::microseconds deadline)
+{
+    if (backend == "uring")
+    {
+	std::unique_ptr<UringEngine> engine = std::make_unique<UringEngine>(socket, rx_depth, tx_depth, deadline);
+	if (engine->open())
+	    return engine;
+    }
+
+    std::unique_ptr<EpollEngine> engine = std::make_unique<EpollEngine>(socket, rx_depth, tx_depth, deadline);
+    if (engine->open())
+	return engine;
+    return nullptr;
+}
@@ -0,0 +1,86 @@
+/*
+   Asynchronous CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef IO_ENGINE_HPP
+#define IO_ENGINE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <linux/can.h>
+#include <linux/types.h>
+
+#include "RxBatch.hpp"
+
+/*
+   Batched frame I/O on one CAN socket, shared by the controller (sending) and the console
+   (receiving).
+
+   Frames are queued with queue() and handed to the kernel together by flush() (or when the
+   queue is full or its deadline expired), received frames are reaped in batches by
+   receive(). Two backends exist: io_uring, which submits and reaps through shared rings,
+   and epoll, which puts the socket in non-blocking mode and uses sendmmsg()/recvmmsg(),
+   waiting in epoll_wait() when the socket is not ready.
+
+   Sending never waits for room in the socket: frames the kernel refuses stay queued, in
+   order, and go out with a later flush. Owners that want to wait call waitWritable().
+*/
+class IoEngine
+{
+protected:
+    int can_socket;
+    // frames of the last receive(), laid out back to back
+    const ReceivedFrame *batch;
+    __u32 kernel_drops;
+
+    explicit IoEngine(int socket) : can_socket(socket), batch(nullptr), kernel_drops(0) {}
+public:
+    /*
+       Creates the named backend ("uring" or "epoll") for the socket. If io_uring is not
+       available (old kernel, disabled by sysctl or seccomp) the epoll backend is used
+       instead. rx_depth bounds the frames returned by one receive(), tx_depth the frames
+       queued before a flush is forced. Returns nullptr if no backend could be set up.
+    */
+    static std::unique_ptr<IoEngine> create(const std::string& backend, int socket,
+					    size_t rx_depth, size_t tx_depth,
+					    std::chrono::microseconds deadline);
+
+    virtual ~IoEngine() = default;
+
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    virtual const char* name() const = 0;
+
+    /*
+       queue a frame, flushing first if the queue is full or its deadline has expired.
+       Returns false (errno EAGAIN or ENOBUFS) if the kernel queue is full and the frame
+       could not be queued either, or (with errno set) on error.
+    */
+    virtual bool queue(const canfd_frame& frame, int mtu) = 0;
+    /*
+       hand every queued frame to the kernel, returns false (with errno set) if some were
+       refused or on error. Refused frames stay queued.
+    */
+    virtual bool flush() = 0;
+    // block until at least one frame is available, returns number of frames or -1 on error
+    virtual int receive() = 0;
+    // frames queued but not yet taken by the kernel
+    virtual size_t pending() const = 0;
+    // wait until the socket may take more frames, or the timeout expires
+    virtual bool waitWritable(std::chrono::microseconds timeout) = 0;
+
+    const ReceivedFrame& received(size_t index) const { return batch[index]; }
+    // running count of frames dropped by the kernel, as reported through SO_RXQ_OVFL
+    __u32 kernelDrops() const { return kernel_drops; }
+
+    virtual unsigned long long framesSent() const = 0;
+    virtual unsigned long long framesReceived() const = 0;
+    virtual unsigned long long syscallCount() const = 0;
+};
+
+#endif
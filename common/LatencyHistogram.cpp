@@ -0,0 +1,89 @@
+/*
+   Latency histogram for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "LatencyHistogram.hpp"
+
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    : counts(sub_bucket_count + (64 - sub_bucket_bits) * sub_bucket_count, 0)
+{
+    reset();
+}
+
+size_t LatencyHistogram::index(uint64_t value)
+{
+    if (value < sub_bucket_count)
+	return value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - sub_bucket_bits;
+    return sub_bucket_count + shift * sub_bucket_count + ((value >> shift) & (sub_bucket_count - 1));
+}
+
+uint64_t LatencyHistogram::highestEquivalentValue(size_t index)
+{
+    if (index < sub_bucket_count)
+	return index;
+
+    int shift = (index - sub_bucket_count) / sub_bucket_count;
+    uint64_t sub_bucket = (index - sub_bucket_count) % sub_bucket_count;
+    uint64_t lowest = (sub_bucket_count + sub_bucket) << shift;
+    return lowest + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(int64_t value)
+{
+    uint64_t magnitude = value > 0 ? value : 0;
+
+    ++counts[index(magnitude)];
+    ++total;
+    sum += magnitude;
+    if (magnitude < minimum)
+	minimum = magnitude;
+    if (magnitude > maximum)
+	maximum = magnitude;
+}
+
+void LatencyHistogram::reset()
+{
+    for (uint64_t& count : counts)
+	count = 0;
+    total = 0;
+    minimum = UINT64_MAX;
+    maximum = 0;
+    sum = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    if (!total)
+	return 0;
+
+    uint64_t target = (uint64_t)std::ceil(fraction * total);
+    if (target < 1)
+	target = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+	seen += counts[i];
+	if (seen >= target)
+	{
+	    uint64_t value = highestEquivalentValue(i);
+	    return value < maximum ? value : maximum;
+	}
+    }
+    return maximum;
+}
+
+void LatencyHistogram::print(std::ostream& out, const std::string& name, double scale, const std::string& unit) const
+{
+    out << name << ": " << total << " samples, min " << min() / scale
+	<< ", p50 " << percentile(0.50) / scale
+	<< ", p99 " << percentile(0.99) / scale
+	<< ", p999 " << percentile(0.999) / scale
+	<< ", max " << max() / scale << " " << unit << std::endl;
+}
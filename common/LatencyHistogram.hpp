@@ -0,0 +1,53 @@
+/*
+   Latency histogram for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+   Log-linear histogram in the style of HdrHistogram.
+
+   Values below 128 are counted exactly. Above that, every power of two is split into 128
+   linear sub-buckets, so any recorded value is reproduced with a relative error below 1%.
+   Recording is O(1) and never allocates; percentiles walk the buckets.
+*/
+class LatencyHistogram
+{
+private:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t minimum;
+    uint64_t maximum;
+    long double sum;
+
+    static size_t index(uint64_t value);
+    // largest value that falls into the same bucket as index
+    static uint64_t highestEquivalentValue(size_t index);
+public:
+    LatencyHistogram();
+
+    void record(int64_t value);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minimum : 0; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total ? (double)(sum / total) : 0.0; }
+    // value below which the given fraction (0.0 - 1.0) of the recorded values fall
+    uint64_t percentile(double fraction) const;
+
+    // one line summary with p50/p99/p999, values are printed divided by scale (e.g. 1000 for ns to us)
+    void print(std::ostream& out, const std::string& name, double scale, const std::string& unit) const;
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+   Multiplexed message decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "MessageDecoder.hpp"
+
+#include <algorithm>
+
+MessageDecoder::MessageDecoder()
+    : multiplexed(false)
+{
+}
+
+MessageDecoder::MessageDecoder(const DbcMessage& message)
+    : base(message), multiplexed(false)
+{
+    const DbcSignal *multiplexor = SignalDatabase::multiplexor(message);
+    if (!multiplexor)
+	return;
+    multiplexed = true;
+
+    DbcMessage selector_message;
+    selector_message.signals.push_back(*multiplexor);
+    selector = DecodePlan(selector_message);
+
+    std::vector<unsigned> values;
+    for (const DbcSignal& signal : message.signals)
+    {
+	if (signal.multiplexing == DbcSignal::Multiplexed)
+	    values.push_back(signal.mux_value);
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
+    // one entry per multiplexor value, and a last one for everything beyond
+    unsigned bits = std::min((unsigned)multiplexor->length, max_table_bits);
+    groups.reserve(values.size() + 1);
+    groups.emplace_back();
+    table.assign(((size_t)1 << bits) + 1, &groups[0]);
+    for (unsigned value : values)
+    {
+	groups.emplace_back(message, value);
+	if (value < table.size() - 1)
+	    table[value] = &groups.back();
+    }
+}
@@ -0,0 +1,69 @@
+/*
+   Multiplexed message decoding for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef MESSAGE_DECODER_HPP
+#define MESSAGE_DECODER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "DecodePlan.hpp"
+#include "SignalDatabase.hpp"
+
+/*
+   Decodes a whole DBC message, plain or multiplexed.
+
+   The signals a message always carries (the multiplexor among them) form one DecodePlan,
+   every multiplexor value with signals of its own another. A table indexed by the raw
+   multiplexor value points at the plan of that value, so a multiplexed frame costs one
+   extra step and one table lookup, and no signal is ever tested for whether it is present.
+   Values without signals, and those beyond the table for multiplexors wider than 12 bits,
+   point at an empty plan.
+*/
+class MessageDecoder
+{
+private:
+    static constexpr unsigned max_table_bits = 12;
+
+    DecodePlan base;
+    DecodePlan selector;
+    std::vector<DecodePlan> groups;
+    std::vector<const DecodePlan*> table;
+    bool multiplexed;
+public:
+    MessageDecoder();
+    explicit MessageDecoder(const DbcMessage& message);
+
+    MessageDecoder(const MessageDecoder&) = delete;
+    MessageDecoder& operator=(const MessageDecoder&) = delete;
+
+    /*
+       physical values of the signals in the frame into values[0 .. size()), the slots of
+       multiplexed signals the frame does not carry are left alone. Returns false if the
+       payload is too short for the signals, mux receives the raw multiplexor value.
+    */
+    bool decode(const unsigned char *data, int length, double *values, long long *mux = nullptr) const
+    {
+	if (!base.decode(data, length, values))
+	    return false;
+	if (!multiplexed)
+	    return true;
+
+	long long value;
+	selector.decodeRaw(data, length, &value);
+	if (mux)
+	    *mux = value;
+	unsigned long long index = value;
+	const DecodePlan *group = table[index < table.size() - 1 ? index : table.size() - 1];
+	return group->decode(data, length, values);
+    }
+
+    size_t size() const { return base.size(); }
+    bool isMultiplexed() const { return multiplexed; }
+    // multiplexor values with signals of their own
+    size_t groupCount() const { return groups.empty() ? 0 : groups.size() - 1; }
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+   Metrics export for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "MetricsFile.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+MetricsFile::MetricsFile(const std::string& path)
+    : path(path)
+{
+}
+
+void MetricsFile::family(const std::string& name, const std::string& help, const char* type)
+{
+    // HELP and TYPE are written once per metric family, before its first sample
+    if (name == last_family)
+	return;
+    buffer << "# HELP " << name << " " << help << "\n";
+    buffer << "# TYPE " << name << " " << type << "\n";
+    last_family = name;
+}
+
+void MetricsFile::counter(const std::string& name, const std::string& help, unsigned long long value, const std::string& labels)
+{
+    family(name, help, "counter");
+    buffer << name;
+    if (!labels.empty())
+	buffer << "{" << labels << "}";
+    buffer << " " << value << "\n";
+}
+
+void MetricsFile::gauge(const std::string& name, const std::string& help, double value, const std::string& labels)
+{
+    family(name, help, "gauge");
+    buffer << name;
+    if (!labels.empty())
+	buffer << "{" << labels << "}";
+    buffer << " " << value << "\n";
+}
+
+bool MetricsFile::commit()
+{
+    std::string temporary = path + ".tmp";
+    bool written;
+    {
+	std::ofstream file(temporary, std::ios::trunc);
+	file << buffer.str();
+	written = file.good();
+    }
+
+    buffer.str("");
+    buffer.clear();
+    last_family.clear();
+
+    if (!written || std::rename(temporary.c_str(), path.c_str()))
+    {
+	std::remove(temporary.c_str());
+	return false;
+    }
+    return true;
+}
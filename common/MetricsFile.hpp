@@ -0,0 +1,38 @@
+/*
+   Metrics export for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef METRICS_FILE_HPP
+#define METRICS_FILE_HPP
+
+#include <sstream>
+#include <string>
+
+/*
+   Writes counters and gauges in the Prometheus text exposition format, so the file can be
+   picked up by the node exporter textfile collector (or simply read by a script).
+
+   The file is written to a temporary path and renamed into place, so readers never see a
+   half written file.
+*/
+class MetricsFile
+{
+private:
+    std::string path;
+    std::ostringstream buffer;
+    std::string last_family;
+
+    void family(const std::string& name, const std::string& help, const char* type);
+public:
+    explicit MetricsFile(const std::string& path);
+
+    // labels are passed preformatted, e.g. id="0x19b"
+    void counter(const std::string& name, const std::string& help, unsigned long long value, const std::string& labels = "");
+    void gauge(const std::string& name, const std::string& help, double value, const std::string& labels = "");
+
+    // replace the file with everything recorded since the last commit, returns false on I/O errors
+    bool commit();
+};
+
+#endif
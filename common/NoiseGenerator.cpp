@@ -0,0 +1,92 @@
+/*
+   Obfuscation noise for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "NoiseGenerator.hpp"
+
+#include <cstring>
+
+typedef uint16_t Words __attribute__((vector_size(32)));
+
+// a byte is replaced when a random 16 bit word is below this, 21846 / 65536 is 1/3 within 0.002 %
+static constexpr uint16_t replace_threshold = 21846;
+
+static uint64_t splitmix64(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+NoiseGenerator::NoiseGenerator(uint64_t seed, int difficulty, uint64_t stream)
+{
+    uint64_t x = seed;
+    x = splitmix64(x) ^ (uint64_t)difficulty;
+    x = splitmix64(x) ^ stream;
+    for (int word = 0; word < 4; ++word)
+    {
+	for (int lane = 0; lane < 4; ++lane)
+	{
+	    state[word][lane] = splitmix64(x);
+	}
+    }
+}
+
+void NoiseGenerator::step(Lanes& result)
+{
+    Lanes sum = state[0] + state[3];
+    result = ((sum << 23) | (sum >> 41)) + state[0];
+
+    Lanes t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = (state[3] << 45) | (state[3] >> 19);
+}
+
+void NoiseGenerator::chunk(Bytes& mask, Bytes& noise)
+{
+    Lanes select, value;
+    step(select);
+    step(value);
+    mask = __builtin_convertvector((Words)((Words)select < replace_threshold), Bytes);
+    // scale the low byte to 0 - 254
+    noise = __builtin_convertvector((((Words)value & 0xff) * 255) >> 8, Bytes);
+}
+
+uint64_t NoiseGenerator::next()
+{
+    Lanes result;
+    step(result);
+    return result[0];
+}
+
+void NoiseGenerator::scramble(unsigned char *data, int start, int stop)
+{
+    for (int offset = start; offset < stop; offset += 16)
+    {
+	int count = stop - offset < 16 ? stop - offset : 16;
+	Bytes bytes = {};
+	memcpy(&bytes, data + offset, count);
+
+	Bytes mask, noise;
+	chunk(mask, noise);
+	bytes = (bytes & ~mask) | (noise & mask);
+	memcpy(data + offset, &bytes, count);
+    }
+}
+
+void NoiseGenerator::fill(unsigned char *mask, unsigned char *noise, size_t length)
+{
+    for (size_t offset = 0; offset < length; offset += 16)
+    {
+	Bytes chunk_mask, chunk_noise;
+	chunk(chunk_mask, chunk_noise);
+	memcpy(mask + offset, &chunk_mask, sizeof(chunk_mask));
+	memcpy(noise + offset, &chunk_noise, sizeof(chunk_noise));
+    }
+}
@@ -0,0 +1,44 @@
+/*
+   Obfuscation noise for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef NOISE_GENERATOR_HPP
+#define NOISE_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+   Random filler bytes, one generator per message stream.
+
+   Four xoshiro256++ generators run side by side in the lanes of a GCC vector, so every
+   step yields 32 random bytes and sixteen frame bytes are scrambled at once with vector
+   compares and selects. About a third of the bytes are replaced, by values from 0 to
+   254. The state is derived from the seed, the difficulty and the stream number only,
+   so the same configuration always produces the same traffic.
+*/
+class NoiseGenerator
+{
+private:
+    typedef uint64_t Lanes __attribute__((vector_size(32)));
+    typedef uint8_t Bytes __attribute__((vector_size(16)));
+
+    Lanes state[4];
+
+    // by reference, a vector return value would depend on the enabled instruction set
+    void step(Lanes& result);
+    // which of sixteen bytes are replaced (0xff) and by what
+    void chunk(Bytes& mask, Bytes& noise);
+public:
+    NoiseGenerator(uint64_t seed = 0, int difficulty = 0, uint64_t stream = 0);
+
+    // replace about a third of the bytes in data[start, stop) with values from 0 to 254
+    void scramble(unsigned char *data, int start, int stop);
+    // the same noise, stored as masks and values for later use, length is a multiple of 16
+    void fill(unsigned char *mask, unsigned char *noise, size_t length);
+    // one random number, for the odd value that is not a filler byte
+    uint64_t next();
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+   Precomputed obfuscation noise for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "NoisePool.hpp"
+
+NoisePool::NoisePool(const std::vector<NoiseGenerator>& generators, size_t block_size, size_t block_count)
+    : block_size((block_size + 63) / 64 * 64), stopping(false), blocks_generated(0), stalls(0)
+{
+    if (this->block_size == 0)
+	this->block_size = 64;
+    streams.resize(generators.size());
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+	Stream& stream = streams[i];
+	stream.generator = generators[i];
+	// two blocks at least, one being used and one being refilled
+	stream.blocks.resize(block_count < 2 ? 2 : block_count);
+	for (Block& block : stream.blocks)
+	{
+	    block.mask.resize(this->block_size);
+	    block.noise.resize(this->block_size);
+	    stream.generator.fill(block.mask.data(), block.noise.data(), this->block_size);
+	}
+	stream.current = 0;
+	stream.offset = 0;
+	stream.ready = stream.blocks.size();
+	stream.next_fill = 0;
+	blocks_generated += stream.blocks.size();
+    }
+
+    helper = std::thread(&NoisePool::refill, this);
+}
+
+NoisePool::~NoisePool()
+{
+    {
+	std::lock_guard<std::mutex> guard(lock);
+	stopping = true;
+    }
+    released.notify_one();
+    helper.join();
+}
+
+NoisePool::Stream *NoisePool::emptied()
+{
+    for (Stream& stream : streams)
+    {
+	if (stream.ready < stream.blocks.size())
+	    return &stream;
+    }
+    return nullptr;
+}
+
+void NoisePool::refill()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+	Stream *stream;
+	released.wait(guard, [this, &stream]() { return stopping || (stream = emptied()); });
+	if (stopping)
+	    return;
+
+	// the consumer never touches a released block, so it is filled without the lock
+	Block& block = stream->blocks[stream->next_fill];
+	guard.unlock();
+	stream->generator.fill(block.mask.data(), block.noise.data(), block_size);
+	guard.lock();
+
+	stream->next_fill = (stream->next_fill + 1) % stream->blocks.size();
+	++stream->ready;
+	++blocks_generated;
+	refilled.notify_one();
+    }
+}
+
+void NoisePool::advance(Stream& stream)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    --stream.ready;
+    released.notify_one();
+    if (!stream.ready)
+    {
+	++stalls;
+	refilled.wait(guard, [&stream]() { return stream.ready > 0; });
+    }
+    stream.current = (stream.current + 1) % stream.blocks.size();
+    stream.offset = 0;
+}
+
+void NoisePool::printStatistics(std::ostream& out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    out << "Noise pool: " << streams.size() << " streams of " << (streams.empty() ? 0 : streams[0].blocks.size())
+	<< " blocks of " << block_size << " bytes, " << blocks_generated << " generated, " << stalls << " stalls" << std::endl;
+}
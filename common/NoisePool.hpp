@@ -0,0 +1,112 @@
+/*
+   Precomputed obfuscation noise for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef NOISE_POOL_HPP
+#define NOISE_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "NoiseGenerator.hpp"
+
+/*
+   Noise for filler bytes, generated ahead of time.
+
+   The pool buffers the output of a set of NoiseGenerator streams (one per message). Every
+   stream has its own ring of blocks, each holding a replace mask and a noise value per byte
+   as its generator produces them. Frames take their filler from the current block of their
+   stream at a running offset, so randomizing a frame is a masked copy and never runs a
+   generator. A used up block is handed back to a helper thread that refills it in the
+   background, continuing the same generator, so the noise of every stream depends only on
+   how that generator was seeded and streams do not change each other. If the helper ever
+   falls behind, the consumer waits for it (counted as a stall) rather than reusing old
+   noise.
+*/
+class NoisePool
+{
+private:
+    struct Block
+    {
+	std::vector<unsigned char> mask;
+	std::vector<unsigned char> noise;
+    };
+
+    struct Stream
+    {
+	NoiseGenerator generator;
+	std::vector<Block> blocks;
+	// consumer side
+	size_t current;
+	size_t offset;
+	// shared with the helper thread, filled blocks counting the current one
+	size_t ready;
+	size_t next_fill;
+    };
+
+    std::vector<Stream> streams;
+    size_t block_size;
+
+    // shared with the helper thread
+    std::mutex lock;
+    std::condition_variable refilled;
+    std::condition_variable released;
+    bool stopping;
+    unsigned long long blocks_generated;
+    unsigned long long stalls;
+
+    std::thread helper;
+
+    void refill();
+    // a stream with a released block, or nullptr
+    Stream *emptied();
+    void advance(Stream& stream);
+    // where the next count bytes of noise start, moving to the next block if they do not fit
+    size_t take(Stream& stream, size_t count)
+    {
+	if (stream.offset + count > block_size)
+	    advance(stream);
+	size_t start = stream.offset;
+	stream.offset += count;
+	return start;
+    }
+public:
+    // block_size and block_count are per stream, block_size is rounded up to a multiple of 64, the largest CAN FD payload
+    NoisePool(const std::vector<NoiseGenerator>& generators, size_t block_size, size_t block_count);
+    ~NoisePool();
+
+    NoisePool(const NoisePool&) = delete;
+    NoisePool& operator=(const NoisePool&) = delete;
+
+    // replace about a third of the bytes in data[start, stop) with values from 0 to 254, from the given stream
+    void scramble(size_t index, unsigned char *data, int start, int stop)
+    {
+	if (stop <= start)
+	    return;
+	Stream& stream = streams[index];
+	size_t count = stop - start;
+	size_t from = take(stream, count);
+	const unsigned char *mask = stream.blocks[stream.current].mask.data() + from;
+	const unsigned char *noise = stream.blocks[stream.current].noise.data() + from;
+	for (size_t i = 0; i < count; ++i)
+	{
+	    data[start + i] = (data[start + i] & ~mask[i]) | (noise[i] & mask[i]);
+	}
+    }
+
+    // one noise value from 0 to 254
+    unsigned char value(size_t index)
+    {
+	Stream& stream = streams[index];
+	return stream.blocks[stream.current].noise[take(stream, 1)];
+    }
+
+    void printStatistics(std::ostream& out);
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+   Memory mapped CAN frame capture for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "PacketRing.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PacketRing::PacketRing()
+    : packet_socket(-1), ifindex(0), map(nullptr), map_size(0), block_index(0), pending(nullptr),
+      kernel_drops(0), frames_received(0), syscalls(0), blocks(0)
+{
+    memset(&request, 0, sizeof(request));
+}
+
+PacketRing::~PacketRing()
+{
+    if (map)
+	munmap(map, map_size);
+    if (packet_socket >= 0)
+	close(packet_socket);
+}
+
+bool PacketRing::open(const char* name, size_t block_size, unsigned block_count, unsigned timeout)
+{
+    ifindex = if_nametoindex(name);
+    if (!ifindex)
+	return false;
+
+    // protocol 0 keeps the socket quiet until the ring is in place and bind() starts the capture
+    packet_socket = socket(AF_PACKET, SOCK_RAW, 0);
+    if (packet_socket < 0)
+	return false;
+
+    int version = TPACKET_V3;
+    if (setsockopt(packet_socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)))
+	return false;
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    block_size = (block_size + page_size - 1) / page_size * page_size;
+    if (!block_size)
+	block_size = page_size;
+    if (!block_count)
+	block_count = 1;
+
+    // in TPACKET_V3 frames are packed back to back, the frame size only has to describe the largest one
+    unsigned frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + CANFD_MTU);
+    request.tp_block_size = block_size;
+    request.tp_block_nr = block_count;
+    request.tp_frame_size = frame_size;
+    request.tp_frame_nr = block_size / frame_size * block_count;
+    request.tp_retire_blk_tov = timeout;
+    if (setsockopt(packet_socket, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)))
+	return false;
+
+    map_size = block_size * block_count;
+    void *ring = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, packet_socket, 0);
+    if (ring == MAP_FAILED)
+	return false;
+    map = (unsigned char *)ring;
+
+    // smallest possible packets, so a full block never needs more entries
+    frames.resize(block_size / TPACKET_ALIGN(TPACKET3_HDRLEN + CAN_MTU));
+    memset(frames.data(), 0, frames.size() * sizeof(ReceivedFrame));
+
+    sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifindex;
+    if (bind(packet_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	return false;
+
+    return true;
+}
+
+void PacketRing::releaseBlock()
+{
+    if (!pending)
+	return;
+
+    __atomic_store_n(&pending->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    pending = nullptr;
+    block_index = (block_index + 1) % request.tp_block_nr;
+}
+
+void PacketRing::updateDrops()
+{
+    // the counters are reset by every read, so they have to be accumulated
+    tpacket_stats_v3 stats;
+    socklen_t length = sizeof(stats);
+    ++syscalls;
+    if (getsockopt(packet_socket, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0)
+	kernel_drops += stats.tp_drops;
+}
+
+int PacketRing::receive()
+{
+    releaseBlock();
+
+    tpacket_block_desc *block = (tpacket_block_desc *)(map + (size_t)block_index * request.tp_block_size);
+    __u32 status;
+    while (!((status = __atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE)) & TP_STATUS_USER))
+    {
+	pollfd descriptor = { packet_socket, POLLIN | POLLERR, 0 };
+	++syscalls;
+	if (poll(&descriptor, 1, -1) < 0 && errno != EINTR)
+	    return -1;
+    }
+    pending = block;
+    ++blocks;
+
+    if (status & TP_STATUS_LOSING)
+	updateDrops();
+
+    int count = 0;
+    unsigned char *position = (unsigned char *)block + block->hdr.bh1.offset_to_first_pkt;
+    for (__u32 i = 0; i < block->hdr.bh1.num_pkts; ++i)
+    {
+	tpacket3_hdr *packet = (tpacket3_hdr *)position;
+	sockaddr_ll *link = (sockaddr_ll *)(position + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+	unsigned short protocol = ntohs(link->sll_protocol);
+	position += packet->tp_next_offset;
+
+	// a frame sent from this host comes once as PACKET_OUTGOING, its echo (PACKET_LOOPBACK) would be a duplicate
+	if (link->sll_pkttype == PACKET_LOOPBACK || link->sll_ifindex != (int)ifindex)
+	    continue;
+	if (protocol != ETH_P_CAN && protocol != ETH_P_CANFD)
+	    continue;
+	if (packet->tp_snaplen > sizeof(canfd_frame) || (size_t)count == frames.size())
+	    continue;
+
+	ReceivedFrame& received = frames[count++];
+	memcpy(&received.frame, (unsigned char *)packet + packet->tp_mac, packet->tp_snaplen);
+	received.length = packet->tp_snaplen;
+	received.timestamp.tv_sec = packet->tp_sec;
+	received.timestamp.tv_nsec = packet->tp_nsec;
+    }
+
+    frames_received += count;
+    return count;
+}
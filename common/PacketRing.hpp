@@ -0,0 +1,84 @@
+/*
+   Memory mapped CAN frame capture for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef PACKET_RING_HPP
+#define PACKET_RING_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <linux/if_packet.h>
+
+#include "RxBatch.hpp"
+
+/*
+   Captures CAN frames from an interface through an AF_PACKET socket with a TPACKET_V3
+   receive ring shared with the kernel.
+
+   The kernel fills whole blocks of frames and hands them over by flipping the block
+   status, so a busy bus costs no syscall at all and an idle one a single poll() per
+   block. A block is handed over when it is full or when the block timeout expires,
+   which bounds the extra latency at low frame rates. Frames are copied out of the
+   block into ReceivedFrame entries (the same shape RxBatch produces) and the block is
+   given back to the kernel on the next receive().
+
+   Unlike a CAN_RAW socket, no CAN id filter is applied: every frame on the interface
+   is delivered, including the ones sent from this host. Those reach packet sockets only
+   as the PACKET_OUTGOING copy, the loopback echo of vcan (and of CAN drivers with
+   IFF_ECHO) is not passed to them, so skipping outgoing frames would hide all traffic of
+   a local controller. Echo copies and frames of other interfaces are skipped, so every
+   frame is delivered once.
+*/
+class PacketRing
+{
+private:
+    int packet_socket;
+    unsigned ifindex;
+    unsigned char *map;
+    size_t map_size;
+    tpacket_req3 request;
+    unsigned block_index;
+    tpacket_block_desc *pending;
+
+    std::vector<ReceivedFrame> frames;
+
+    unsigned long long kernel_drops;
+    unsigned long long frames_received;
+    unsigned long long syscalls;
+    unsigned long long blocks;
+
+    void releaseBlock();
+    void updateDrops();
+public:
+    PacketRing();
+    ~PacketRing();
+
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    /*
+       Sets up the ring on the named interface. block_size is rounded up to a multiple of the
+       page size, timeout is the block retire timeout in milliseconds (0 lets the kernel pick).
+       Returns false (with errno set) if any step fails.
+    */
+    bool open(const char* name, size_t block_size, unsigned block_count, unsigned timeout);
+
+    // block until the kernel hands over a block, returns number of frames or -1 on error
+    int receive();
+
+    const ReceivedFrame& received(size_t index) const { return frames[index]; }
+    const canfd_frame& frame(size_t index) const { return frames[index].frame; }
+    size_t length(size_t index) const { return frames[index].length; }
+    const timespec& timestamp(size_t index) const { return frames[index].timestamp; }
+
+    // running count of frames the kernel could not place in the ring (PACKET_STATISTICS)
+    unsigned long long kernelDrops() const { return kernel_drops; }
+    unsigned long long framesReceived() const { return frames_received; }
+    unsigned long long syscallCount() const { return syscalls; }
+    unsigned long long blockCount() const { return blocks; }
+    double framesPerSyscall() const { return syscalls ? (double)frames_received / syscalls : 0.0; }
+};
+
+#endif
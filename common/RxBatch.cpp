@@ -0,0 +1,89 @@
+/*
+   Batched CAN frame reception for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "RxBatch.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+RxBatch::RxBatch(int socket, size_t capacity)
+    : can_socket(socket), capacity(capacity ? capacity : 1),
+      frames(this->capacity), addrs(this->capacity), iov(this->capacity), msgs(this->capacity),
+      control(this->capacity * control_size),
+      kernel_drops(0), frames_received(0), syscalls(0)
+{
+    memset(msgs.data(), 0, msgs.size() * sizeof(mmsghdr));
+    memset(frames.data(), 0, frames.size() * sizeof(ReceivedFrame));
+    for (size_t i = 0; i < this->capacity; ++i)
+    {
+	iov[i].iov_base = &frames[i].frame;
+	iov[i].iov_len = sizeof(canfd_frame);
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+	msgs[i].msg_hdr.msg_name = &addrs[i];
+	msgs[i].msg_hdr.msg_control = &control[i * control_size];
+    }
+}
+
+int RxBatch::receive()
+{
+    // the kernel overwrites these on every call, so they have to be reset
+    for (size_t i = 0; i < capacity; ++i)
+    {
+	msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_can);
+	msgs[i].msg_hdr.msg_controllen = control_size;
+	msgs[i].msg_hdr.msg_flags = 0;
+    }
+
+    int count;
+    do
+    {
+	++syscalls;
+	count = recvmmsg(can_socket, msgs.data(), capacity, MSG_WAITFORONE, NULL);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0)
+	return -1;
+    frames_received += count;
+
+    for (int i = 0; i < count; ++i)
+    {
+	frames[i].length = msgs[i].msg_len;
+	readControl(&msgs[i].msg_hdr, frames[i].timestamp, kernel_drops);
+    }
+
+    return count;
+}
+
+void RxBatch::readControl(msghdr *msg, timespec& timestamp, __u32& kernel_drops)
+{
+    timestamp.tv_sec = 0;
+    timestamp.tv_nsec = 0;
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+	 cmsg && (cmsg->cmsg_level == SOL_SOCKET);
+	 cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+	if (cmsg->cmsg_type == SO_TIMESTAMPING)
+	{
+	    // ts[0] holds the software timestamp
+	    memcpy(&timestamp, CMSG_DATA(cmsg), sizeof(timespec));
+	}
+	else if (cmsg->cmsg_type == SO_TIMESTAMPNS)
+	{
+	    memcpy(&timestamp, CMSG_DATA(cmsg), sizeof(timespec));
+	}
+	else if (cmsg->cmsg_type == SO_TIMESTAMP)
+	{
+	    timeval tv;
+	    memcpy(&tv, CMSG_DATA(cmsg), sizeof(timeval));
+	    timestamp.tv_sec = tv.tv_sec;
+	    timestamp.tv_nsec = tv.tv_usec * 1000;
+	}
+	else if (cmsg->cmsg_type == SO_RXQ_OVFL)
+	{
+	    memcpy(&kernel_drops, CMSG_DATA(cmsg), sizeof(__u32));
+	}
+    }
+}
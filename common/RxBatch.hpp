@@ -0,0 +1,81 @@
+/*
+   Batched CAN frame reception for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef RX_BATCH_HPP
+#define RX_BATCH_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <vector>
+
+#include <linux/can.h>
+#include <linux/errqueue.h>
+#include <linux/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+// a frame together with what the receive path learned about it
+struct ReceivedFrame
+{
+    canfd_frame frame;
+    timespec timestamp;   // kernel receive time, zero when unknown
+    size_t length;        // bytes received, CAN_MTU or CANFD_MTU
+
+    // payload bytes that can be trusted, len clamped to the frame type
+    int dataLength() const
+    {
+	int max = length == CANFD_MTU ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+	return frame.len > max ? max : frame.len;
+    }
+};
+
+/*
+   Pulls up to capacity frames out of a socket with a single recvmmsg() call.
+
+   All buffers (frames, addresses and control messages) are allocated once, so receiving
+   a batch does not allocate. Per frame timestamps are taken from the SO_TIMESTAMPING
+   (software receive stamp), SO_TIMESTAMPNS or SO_TIMESTAMP control messages, whichever
+   the socket has enabled. Frames without a timestamp report zero.
+*/
+class RxBatch
+{
+private:
+    static constexpr size_t control_size = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(__u32));
+
+    int can_socket;
+    size_t capacity;
+
+    std::vector<ReceivedFrame> frames;
+    std::vector<sockaddr_can> addrs;
+    std::vector<iovec> iov;
+    std::vector<mmsghdr> msgs;
+    std::vector<char> control;
+
+    __u32 kernel_drops;
+    unsigned long long frames_received;
+    unsigned long long syscalls;
+public:
+    RxBatch(int socket, size_t capacity);
+
+    // block until at least one frame is available, returns number of frames or -1 on error
+    int receive();
+
+    // timestamp and running drop count from the control messages of one received message
+    static void readControl(msghdr *msg, timespec& timestamp, __u32& kernel_drops);
+
+    const ReceivedFrame& received(size_t index) const { return frames[index]; }
+    const canfd_frame& frame(size_t index) const { return frames[index].frame; }
+    size_t length(size_t index) const { return frames[index].length; }
+    const timespec& timestamp(size_t index) const { return frames[index].timestamp; }
+
+    // running count of frames dropped by the kernel, as reported through SO_RXQ_OVFL
+    __u32 kernelDrops() const { return kernel_drops; }
+    unsigned long long framesReceived() const { return frames_received; }
+    unsigned long long syscallCount() const { return syscalls; }
+    double framesPerSyscall() const { return syscalls ? (double)frames_received / syscalls : 0.0; }
+};
+
+#endif
@@ -0,0 +1,251 @@
+/*
+   DBC signal database for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "SignalDatabase.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// next bit of a Motorola signal, going from the most to the least significant one
+static int nextMotorolaBit(int bit)
+{
+    return bit % 8 == 0 ? bit + 15 : bit - 1;
+}
+
+int SignalDatabase::endByte(const DbcSignal& signal)
+{
+    if (!signal.big_endian)
+	return (signal.start_bit + signal.length + 7) / 8;
+
+    int bits_in_first_byte = signal.start_bit % 8 + 1;
+    int byte = signal.start_bit / 8;
+    if (signal.length <= bits_in_first_byte)
+	return byte + 1;
+    return byte + 1 + (signal.length - bits_in_first_byte + 7) / 8;
+}
+
+unsigned long long SignalDatabase::rawValue(const DbcSignal& signal, const unsigned char *data)
+{
+    unsigned long long value = 0;
+    if (signal.big_endian)
+    {
+	int bit = signal.start_bit;
+	for (int i = 0; i < signal.length; ++i)
+	{
+	    value = (value << 1) | ((data[bit / 8] >> (bit % 8)) & 1);
+	    bit = nextMotorolaBit(bit);
+	}
+    }
+    else
+    {
+	for (int i = signal.length - 1; i >= 0; --i)
+	{
+	    int bit = signal.start_bit + i;
+	    value = (value << 1) | ((data[bit / 8] >> (bit % 8)) & 1);
+	}
+    }
+    return value;
+}
+
+const DbcSignal* SignalDatabase::multiplexor(const DbcMessage& message)
+{
+    for (const DbcSignal& signal : message.signals)
+    {
+	if (signal.multiplexing == DbcSignal::Multiplexor)
+	    return &signal;
+    }
+    return nullptr;
+}
+
+const DbcMessage* SignalDatabase::find(canid_t id) const
+{
+    for (const DbcMessage& message : message_list)
+    {
+	if (message.id == id)
+	    return &message;
+    }
+    return nullptr;
+}
+
+const DbcMessage* SignalDatabase::find(const std::string& name) const
+{
+    for (const DbcMessage& message : message_list)
+    {
+	if (message.name == name)
+	    return &message;
+    }
+    return nullptr;
+}
+
+bool SignalDatabase::load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+	std::cerr << "Error: cannot open DBC file " << path << std::endl;
+	return false;
+    }
+    return parse(in, path);
+}
+
+// BO_ <id> <name>: <length> <sender>
+bool SignalDatabase::parseMessage(const std::string& line, DbcMessage& message)
+{
+    std::istringstream in(line);
+    std::string keyword;
+    unsigned long id;
+    if (!(in >> keyword >> id >> message.name))
+	return false;
+    if (message.name.back() == ':')
+    {
+	message.name.pop_back();
+    }
+    else
+    {
+	std::string colon;
+	if (!(in >> colon) || colon != ":")
+	    return false;
+    }
+    if (!(in >> message.length))
+	return false;
+    in >> message.sender;
+
+    message.id = id & (CAN_EFF_FLAG | CAN_EFF_MASK);
+    if (!(message.id & CAN_EFF_FLAG) && message.id > CAN_SFF_MASK)
+	return false;
+    return message.length >= 0 && message.length <= CANFD_MAX_DLEN && !message.name.empty();
+}
+
+// SG_ <name> [multiplexing] : <start>|<length>@<order><sign> (<factor>,<offset>) [<minimum>|<maximum>] "<unit>" <receivers>
+bool SignalDatabase::parseSignal(const std::string& line, DbcSignal& signal)
+{
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+	return false;
+
+    std::istringstream head(line.substr(0, colon));
+    std::string keyword, multiplexing;
+    if (!(head >> keyword >> signal.name))
+	return false;
+    signal.multiplexing = DbcSignal::Plain;
+    signal.mux_value = 0;
+    if (head >> multiplexing)
+    {
+	if (multiplexing == "M")
+	{
+	    signal.multiplexing = DbcSignal::Multiplexor;
+	}
+	else if (multiplexing[0] == 'm' && multiplexing.size() > 1 && isdigit((unsigned char)multiplexing[1]))
+	{
+	    signal.multiplexing = DbcSignal::Multiplexed;
+	    signal.mux_value = strtoul(multiplexing.c_str() + 1, NULL, 10);
+	}
+	else
+	{
+	    return false;
+	}
+    }
+
+    char order, sign;
+    int consumed = 0;
+    if (sscanf(line.c_str() + colon + 1, " %d | %d @ %c %c ( %lf , %lf ) [ %lf | %lf ]%n",
+	       &signal.start_bit, &signal.length, &order, &sign, &signal.factor, &signal.offset,
+	       &signal.minimum, &signal.maximum, &consumed) != 8)
+	return false;
+    if ((order != '0' && order != '1') || (sign != '+' && sign != '-'))
+	return false;
+    signal.big_endian = order == '0';
+    signal.is_signed = sign == '-';
+
+    signal.unit.clear();
+    size_t quote = line.find('"', colon + 1 + consumed);
+    if (quote != std::string::npos)
+    {
+	size_t end = line.find('"', quote + 1);
+	if (end != std::string::npos)
+	    signal.unit = line.substr(quote + 1, end - quote - 1);
+    }
+    return signal.length > 0 && signal.length <= 64 && signal.start_bit >= 0;
+}
+
+bool SignalDatabase::parse(std::istream& in, const std::string& name)
+{
+    message_list.clear();
+    std::string line;
+    int line_number = 0;
+    DbcMessage *current = nullptr;
+
+    while (std::getline(in, line))
+    {
+	++line_number;
+	size_t first = line.find_first_not_of(" \t\r");
+	if (first == std::string::npos)
+	{
+	    current = nullptr;
+	    continue;
+	}
+
+	std::string keyword = line.substr(first, line.find_first_of(" \t", first) - first);
+	if (keyword == "BO_")
+	{
+	    DbcMessage message;
+	    if (!parseMessage(line.substr(first), message))
+	    {
+		std::cerr << "Error: " << name << ":" << line_number << ": invalid message definition" << std::endl;
+		return false;
+	    }
+	    message_list.push_back(message);
+	    current = &message_list.back();
+	}
+	else if (keyword == "SG_")
+	{
+	    DbcSignal signal;
+	    if (!current)
+	    {
+		std::cerr << "Error: " << name << ":" << line_number << ": signal outside of a message" << std::endl;
+		return false;
+	    }
+	    if (!parseSignal(line.substr(first), signal))
+	    {
+		std::cerr << "Error: " << name << ":" << line_number << ": invalid signal definition" << std::endl;
+		return false;
+	    }
+	    if (endByte(signal) > current->length || (signal.big_endian && signal.start_bit / 8 >= current->length))
+	    {
+		std::cerr << "Error: " << name << ":" << line_number << ": signal " << signal.name
+			  << " does not fit in the " << current->length << " bytes of " << current->name << std::endl;
+		return false;
+	    }
+	    if (signal.multiplexing == DbcSignal::Multiplexor && multiplexor(*current))
+	    {
+		std::cerr << "Error: " << name << ":" << line_number << ": second multiplexor in " << current->name << std::endl;
+		return false;
+	    }
+	    current->signals.push_back(signal);
+	}
+	else
+	{
+	    current = nullptr;
+	}
+    }
+
+    for (const DbcMessage& message : message_list)
+    {
+	for (const DbcSignal& signal : message.signals)
+	{
+	    if (signal.multiplexing == DbcSignal::Multiplexed && !multiplexor(message))
+	    {
+		std::cerr << "Error: " << name << ": multiplexed signal " << signal.name << " in "
+			  << message.name << ", which has no multiplexor" << std::endl;
+		return false;
+	    }
+	}
+    }
+    return true;
+}
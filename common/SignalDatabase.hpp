@@ -0,0 +1,85 @@
+/*
+   DBC signal database for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef SIGNAL_DATABASE_HPP
+#define SIGNAL_DATABASE_HPP
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <linux/can.h>
+
+// one signal of a message, as described by an SG_ line
+struct DbcSignal
+{
+    enum Multiplexing
+    {
+	Plain,
+	Multiplexor,   // M, selects which multiplexed signals the frame carries
+	Multiplexed    // m<value>, present when the multiplexor has that value
+    };
+
+    std::string name;
+    // DBC numbering: the least significant bit for Intel byte order, the most significant one for Motorola
+    int start_bit;
+    int length;
+    bool big_endian;   // Motorola byte order (@0)
+    bool is_signed;
+    double factor;
+    double offset;
+    double minimum;
+    double maximum;
+    std::string unit;
+    Multiplexing multiplexing;
+    unsigned mux_value;
+};
+
+// one message, as described by a BO_ line and the SG_ lines following it
+struct DbcMessage
+{
+    canid_t id;        // CAN_EFF_FLAG set for extended ids, as in the DBC file
+    std::string name;
+    int length;
+    std::string sender;
+    std::vector<DbcSignal> signals;
+};
+
+/*
+   Messages and signals loaded from a DBC file.
+
+   Only the parts needed to decode frames are read: message definitions (BO_) and their
+   signals (SG_) with multiplexing, start bit, length, byte order, signedness, factor,
+   offset, range and unit. Everything else (nodes, comments, attributes, value tables) is
+   skipped. A message has at most one multiplexor, signals that are multiplexed and a
+   multiplexor themselves (m<value>M, extended multiplexing) are read as multiplexed
+   signals only.
+*/
+class SignalDatabase
+{
+private:
+    std::vector<DbcMessage> message_list;
+
+    bool parseMessage(const std::string& line, DbcMessage& message);
+    bool parseSignal(const std::string& line, DbcSignal& signal);
+public:
+    // load a DBC file, on errors a message naming the file and line goes to std::cerr and false is returned
+    bool load(const std::string& path);
+    bool parse(std::istream& in, const std::string& name);
+
+    const std::vector<DbcMessage>& messages() const { return message_list; }
+    // nullptr if there is no such message
+    const DbcMessage* find(canid_t id) const;
+    const DbcMessage* find(const std::string& name) const;
+    // the multiplexor signal of a message, nullptr for plain messages
+    static const DbcSignal* multiplexor(const DbcMessage& message);
+
+    // last payload byte (plus one) holding a bit of the signal
+    static int endByte(const DbcSignal& signal);
+    // raw value of the signal, read bit by bit, for reference and for signals no decode plan step can hold
+    static unsigned long long rawValue(const DbcSignal& signal, const unsigned char *data);
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+   Simulation configuration for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef SIMULATION_CONFIG_HPP
+#define SIMULATION_CONFIG_HPP
+
+#include <string>
+#include <vector>
+
+#include "can.hpp"
+#include "simulator.hpp"
+
+// identifier, signal placement and schedule of one of the vehicle messages
+struct MessageLayout
+{
+    int id;
+    // payload byte of the signal
+    int position;
+    // payload bytes up to the end of the signal
+    int length;
+    // total payload length, the bytes after the signal are random filler. 0 ends the frame
+    // right after the signal, FD frames are rounded up to a valid FD length
+    int frame_length;
+    // transmission period in milliseconds, 0 disables the diagnostic frame (the others need one)
+    int period;
+    // phase of the first transmission relative to controller start, in milliseconds
+    int offset;
+    // sent as a CAN FD frame
+    bool fd;
+};
+
+/*
+   Everything one simulated vehicle is configured with, as ConfigurationParser::parse()
+   returns it. Controller and Console take their own copy, so vehicles with different
+   layouts can share a process, and the per frame paths read one compact struct. The
+   message layouts come first, they are what every frame touches.
+*/
+struct SimulationConfig
+{
+    struct Messages
+    {
+	MessageLayout door = { 411, 2, 3, 0, 10, 0, false };
+	MessageLayout signal = { 392, 0, 3, 0, 500, 0, false };
+	MessageLayout speed = { 580, 3, 5, 0, 10, 0, false };
+	// carries the controller transmit time, used to measure end to end latency
+	MessageLayout diagnostic = { 1791, 0, 8, 0, 100, 0, false };
+	// bit rate switch of the FD frames, the data phase goes at the data bitrate
+	bool brs = true;
+	// error state indicator of the sending node
+	bool esi = false;
+	// background traffic, any number of additional periodic frames
+	std::vector<PeriodicFrame> periodic;
+    } messages;
+
+    // bits of the door and turn signal messages
+    struct Equipment
+    {
+	int left_signal = 1;
+	int right_signal = 2;
+	int door1 = 1;
+	int door2 = 2;
+	int door3 = 4;
+	int door4 = 8;
+    } equipment;
+
+    struct Car
+    {
+	float maximum_speed = 90.0;
+	float acceleration_rate = 8.0;
+	// states the console shows the doors and turn signals in
+	int door_locked = 0;
+	int door_unlocked = 1;
+	int turn_signal_off = 0;
+	int turn_signal_on = 1;
+    } car;
+
+    struct Controller
+    {
+	// maximum number of frames handed to the kernel in one sendmmsg() call
+	int tx_batch_size = 32;
+	// queued frames older than this (in microseconds) are flushed immediately
+	int tx_flush_deadline = 2000;
+	// length of one scheduler tick in microseconds, periods and offsets are rounded to it
+	int tick_resolution = 1000;
+	// frames held while the kernel queue of the interface is full
+	int tx_queue_size = 1024;
+	// what happens when that queue is full as well: "drop-oldest", "drop-newest" or "block"
+	std::string tx_overflow = "drop-oldest";
+	// simulated bus bitrate in bit/s (e.g. 125000, 250000, 500000, 1000000), frames are released
+	// no faster than that bus could carry them, 0 sends as fast as the socket takes them
+	int bitrate = 0;
+	// bitrate of the data phase of CAN FD frames sent with BRS
+	int data_bitrate = 2000000;
+	// how stuff bits are counted: "exact" or "worst-case"
+	std::string bit_stuffing = "exact";
+	// obfuscation level, from 2 on the filler bytes around every signal are randomized
+	int difficulty = 1;
+	// seed of that noise, the same seed and difficulty always give the same traffic
+	unsigned long long seed = 0;
+	// that noise is generated ahead of time by a helper thread, in this many blocks of this many
+	// bytes for every message. 0 blocks generates it on the sending thread
+	int noise_blocks = 4;
+	int noise_block_size = 4096;
+    } controller;
+
+    struct Console
+    {
+	// how frames are captured: "raw" (CAN_RAW socket and recvmmsg) or "mmap" (AF_PACKET TPACKET_V3 ring)
+	std::string capture = "raw";
+	// bytes per ring block in mmap capture, rounded up to the page size
+	int packet_block_size = 65536;
+	// ring blocks in mmap capture
+	int packet_blocks = 64;
+	// milliseconds after which a partly filled block is handed over in mmap capture
+	int packet_block_timeout = 1;
+	// maximum number of frames pulled from the kernel in one recvmmsg() call
+	int rx_batch_size = 64;
+	// install CAN_RAW_FILTER for the configured message ids, so other traffic is dropped in the kernel
+	bool kernel_filter = true;
+	// extra filters, raw CAN ids with the usual CAN_EFF_FLAG / CAN_RTR_FLAG / CAN_INV_FILTER bits
+	std::vector<FilterMask> filters;
+	// when set, only the extra filters are installed and a frame must match all of them
+	bool join_filters = false;
+	// threads decoding frames handed over by the receive thread, 0 decodes on the receive thread
+	int decoder_threads = 1;
+	// frames each decoder ring can hold
+	int ring_size = 4096;
+	// how long (in microseconds) the receive thread waits for a full ring before dropping the frame
+	int backpressure_timeout = 1000;
+	// dashboard redraws per second, 0 disables the dashboard
+	int refresh_rate = 30;
+	// Prometheus text format file refreshed with every statistics report, empty disables it
+	std::string metrics_file;
+	// DBC file whose messages are decoded as well, empty disables it
+	std::string database;
+    } console;
+
+    struct Generator
+    {
+	// replace the vehicle messages of the controller with generated load
+	bool enabled = false;
+	// target frames per second, 0 together with a busload of 0 sends as fast as the socket takes them
+	int fps = 10000;
+	// target busload in percent of controller.bitrate, takes precedence over fps when above 0
+	double busload = 0;
+	// identifier mix, ids above 0x7ff are sent as extended frames, empty uses 0x100 - 0x1ff evenly
+	std::vector<GeneratorId> ids;
+	// payload lengths are spread evenly over this range, FD lengths are rounded up to a valid FD length
+	int min_length = 8;
+	int max_length = 8;
+	// send CAN FD frames (up to 64 bytes), with or without bit rate switch
+	bool fd = false;
+	bool brs = true;
+	// payload bytes: "random", "zero" or "counter" (a running frame number)
+	std::string payload = "random";
+    } generator;
+
+    // interval (in milliseconds) between statistics reports, 0 disables them
+    int statistics_interval = 5000;
+    // socket I/O backend of both binaries: "uring" (io_uring, falls back to epoll when unavailable) or "epoll"
+    std::string io_backend = "uring";
+};
+
+#endif
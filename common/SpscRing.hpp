@@ -0,0 +1,94 @@
+/*
+   Single producer / single consumer ring for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*
+   Lock-free bounded ring for exactly one producer thread and one consumer thread.
+
+   The producer owns head, the consumer owns tail; each side keeps a cached copy of the
+   other index so the shared cache line is only touched when the ring looks full (or
+   empty). Indices, caches and slots are kept on separate cache lines to avoid false
+   sharing. Capacity is rounded up to a power of two.
+*/
+template <typename T>
+class SpscRing
+{
+private:
+    static constexpr size_t cache_line = 64;
+
+    struct alignas(cache_line) Slot
+    {
+	T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    alignas(cache_line) std::atomic<size_t> head;
+    size_t cached_tail;
+
+    alignas(cache_line) std::atomic<size_t> tail;
+    size_t cached_head;
+
+    alignas(cache_line) std::atomic<size_t> high_watermark;
+public:
+    explicit SpscRing(size_t capacity)
+	: head(0), cached_tail(0), tail(0), cached_head(0), high_watermark(0)
+    {
+	size_t size = 2;
+	while (size < capacity)
+	    size <<= 1;
+	slots.reset(new Slot[size]);
+	mask = size - 1;
+    }
+
+    // producer side, returns false when the ring is full
+    bool push(const T& value)
+    {
+	size_t position = head.load(std::memory_order_relaxed);
+	if (position - cached_tail > mask)
+	{
+	    cached_tail = tail.load(std::memory_order_acquire);
+	    if (position - cached_tail > mask)
+		return false;
+	}
+
+	slots[position & mask].value = value;
+	head.store(position + 1, std::memory_order_release);
+
+	size_t used = position + 1 - cached_tail;
+	if (used > high_watermark.load(std::memory_order_relaxed))
+	    high_watermark.store(used, std::memory_order_relaxed);
+	return true;
+    }
+
+    // consumer side, returns false when the ring is empty
+    bool pop(T& value)
+    {
+	size_t position = tail.load(std::memory_order_relaxed);
+	if (position == cached_head)
+	{
+	    cached_head = head.load(std::memory_order_acquire);
+	    if (position == cached_head)
+		return false;
+	}
+
+	value = slots[position & mask].value;
+	tail.store(position + 1, std::memory_order_release);
+	return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+    // largest fill level seen by the producer (an upper bound, based on its cached tail)
+    size_t highWatermark() const { return high_watermark.load(std::memory_order_relaxed); }
+};
+
+#endif
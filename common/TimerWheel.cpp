@@ -0,0 +1,172 @@
+/*
+   Hierarchical timer wheel for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "TimerWheel.hpp"
+
+#include <cstring>
+
+TimerWheel::TimerWheel()
+    : active(0), current(1)
+{
+    memset(level0_bitmap, 0, sizeof(level0_bitmap));
+}
+
+void TimerWheel::release(uint32_t index)
+{
+    Timer& timer = timers[index];
+    timer.state = State::Free;
+    // bump the generation so stale ids can no longer cancel the recycled timer
+    ++timer.generation;
+    free_timers.push_back(index);
+}
+
+void TimerWheel::insert(uint32_t index)
+{
+    Timer& timer = timers[index];
+    uint64_t expires = timer.expires;
+    uint64_t delta = expires - current;
+    Slot *slot;
+
+    if (expires < current)
+    {
+	// already due, run it on the next processed tick
+	expires = current;
+	delta = 0;
+    }
+
+    if (delta < level0_size)
+    {
+	uint32_t position = expires & (level0_size - 1);
+	slot = &level0[position];
+	level0_bitmap[position / 64] |= 1ULL << (position % 64);
+    }
+    else
+    {
+	int level = 0;
+	int shift = level0_bits;
+	while (level < levels - 2 && delta >= (1ULL << (shift + level_bits)))
+	{
+	    ++level;
+	    shift += level_bits;
+	}
+	if (delta >= (1ULL << (shift + level_bits)))
+	{
+	    // beyond the range of the wheel, park it in the farthest slot
+	    expires = current + (1ULL << (shift + level_bits)) - 1;
+	}
+	slot = &upper[level][(expires >> shift) & (level_size - 1)];
+    }
+
+    slot->push_back(index);
+    timer.state = State::Queued;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(uint64_t delay, uint64_t period, uint64_t value)
+{
+    uint32_t index;
+    if (!free_timers.empty())
+    {
+	index = free_timers.back();
+	free_timers.pop_back();
+    }
+    else
+    {
+	index = timers.size();
+	timers.push_back(Timer());
+    }
+
+    Timer& timer = timers[index];
+    timer.expires = now() + (delay ? delay : 1);
+    timer.period = period;
+    timer.value = value;
+    ++active;
+    insert(index);
+
+    // the generation lives in the upper half so that a valid id is never zero
+    return ((uint64_t)(timer.generation + 1) << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    uint32_t index = id & 0xffffffff;
+    uint32_t generation = (id >> 32) - 1;
+    if (id == InvalidTimer || index >= timers.size())
+	return false;
+
+    Timer& timer = timers[index];
+    if (timer.generation != generation)
+	return false;
+    if (timer.state != State::Queued && timer.state != State::Running)
+	return false;
+
+    // a queued timer stays in its slot until the slot is processed, a running one until rearm()
+    timer.state = State::Cancelled;
+    --active;
+    return true;
+}
+
+void TimerWheel::cascade()
+{
+    // level 0 wrapped, pull the next block of timers down from each level that wrapped too
+    int shift = level0_bits;
+    for (int level = 0; level < levels - 1; ++level)
+    {
+	uint32_t position = (current >> shift) & (level_size - 1);
+	expiring.swap(upper[level][position]);
+	for (uint32_t index : expiring)
+	{
+	    if (timers[index].state == State::Queued)
+		insert(index);
+	    else
+		release(index);
+	}
+	expiring.clear();
+	if (position)
+	    break;
+	shift += level_bits;
+    }
+}
+
+void TimerWheel::take(uint32_t slot)
+{
+    expiring.swap(level0[slot]);
+    level0_bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+void TimerWheel::rearm(uint32_t index)
+{
+    Timer& timer = timers[index];
+    if (timer.state == State::Running && timer.period)
+    {
+	timer.expires += timer.period;
+	insert(index);
+	return;
+    }
+    if (timer.state == State::Running)
+	--active;
+    release(index);
+}
+
+uint64_t TimerWheel::nextExpiry() const
+{
+    uint32_t start = current & (level0_size - 1);
+
+    // the cascade for this rotation has not run yet, anything in the upper levels may be due
+    if (!start)
+	return current;
+
+    // scan the level 0 bitmap from the current slot up to the end of this rotation
+    for (uint32_t word = start / 64; word < level0_size / 64; ++word)
+    {
+	uint64_t bits = level0_bitmap[word];
+	if (word == start / 64)
+	    bits &= ~0ULL << (start % 64);
+	if (bits)
+	    return current + (word * 64 + __builtin_ctzll(bits)) - start;
+    }
+
+    // nothing left in this rotation, level 0 slots below start belong to the next one
+    return current + (level0_size - start);
+}
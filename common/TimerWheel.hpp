@@ -0,0 +1,139 @@
+/*
+   Hierarchical timer wheel for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+   Hierarchical timing wheel in the style of the classic Linux kernel timers.
+
+   Time is measured in abstract ticks. Level 0 has 1024 slots of one tick each, levels 1 to 3
+   have 64 slots each covering 1024, 65536 and 4194304 ticks, so timers up to 2^28 ticks ahead
+   can be held. Scheduling, cancelling and expiring a timer are all O(1); timers in the upper
+   levels are moved down ("cascaded") once per rotation of the level below. With 1 ms ticks,
+   level 0 spans the 1 ms to 1 s periods of CAN messages, so they never cascade.
+
+   Timers carry a 64 bit value instead of a callback. advance() hands the value of every
+   expired timer to a single handler, which is inlined into the caller, so an expiry costs a
+   read of the slot array and of the timer, and no indirect call. Slots are arrays of timer
+   indices that keep their capacity, so once the wheel has turned over it does not allocate.
+
+   The handler may schedule or cancel timers (or cancel the one that is expiring) while the
+   wheel is advancing. Cancelled timers are dropped when their slot is next processed.
+*/
+class TimerWheel
+{
+public:
+    using TimerId = uint64_t;
+
+    static constexpr TimerId InvalidTimer = 0;
+private:
+    static constexpr int levels = 4;
+    static constexpr int level0_bits = 10;
+    static constexpr int level_bits = 6;
+    static constexpr uint32_t level0_size = 1 << level0_bits;
+    static constexpr uint32_t level_size = 1 << level_bits;
+
+    enum class State : uint8_t
+    {
+	Free,
+	Queued,
+	Running,
+	Cancelled
+    };
+
+    struct Timer
+    {
+	uint64_t expires;
+	uint64_t period;
+	uint64_t value;
+	uint32_t generation;
+	State state;
+    };
+
+    using Slot = std::vector<uint32_t>;
+
+    std::vector<Timer> timers;
+    std::vector<uint32_t> free_timers;
+    size_t active;
+
+    // next tick that has not been processed yet
+    uint64_t current;
+
+    Slot level0[level0_size];
+    Slot upper[levels - 1][level_size];
+    uint64_t level0_bitmap[level0_size / 64];
+    // timers of the slot that is currently being expired
+    Slot expiring;
+
+    void release(uint32_t index);
+    void insert(uint32_t index);
+    void cascade();
+    // move the timers of a level 0 slot to expiring
+    void take(uint32_t slot);
+    // reinsert a timer whose handler has run, or release it
+    void rearm(uint32_t index);
+public:
+    TimerWheel();
+
+    // hand value to the handler after delay ticks (at least one), and then every period ticks when period is non-zero
+    TimerId schedule(uint64_t delay, uint64_t period, uint64_t value);
+    // returns false if the timer already expired (one shot) or was cancelled before
+    bool cancel(TimerId id);
+
+    // process every tick up to and including tick, calling handler(value) for each expired timer
+    template <typename Handler>
+    void advance(uint64_t tick, Handler&& handler);
+
+    // last processed tick
+    uint64_t now() const { return current - 1; }
+    /*
+       Earliest tick at which a timer may expire. This never overshoots: when no timer is
+       due within the current level 0 rotation, the tick of the next cascade is returned.
+    */
+    uint64_t nextExpiry() const;
+    size_t size() const { return active; }
+};
+
+template <typename Handler>
+void TimerWheel::advance(uint64_t tick, Handler&& handler)
+{
+    while (current <= tick)
+    {
+	uint32_t slot = current & (level0_size - 1);
+	if (!slot)
+	    cascade();
+
+	// the handler sees the tick being processed as now()
+	++current;
+	if (level0[slot].empty())
+	    continue;
+
+	/*
+	   A periodic timer with a period of exactly one rotation is reinserted into this very
+	   slot, taking the slot first keeps it from running twice in the same tick.
+	*/
+	take(slot);
+	for (size_t i = 0; i < expiring.size(); ++i)
+	{
+	    uint32_t index = expiring[i];
+	    if (timers[index].state != State::Queued)
+	    {
+		release(index);
+		continue;
+	    }
+	    timers[index].state = State::Running;
+	    handler(timers[index].value);
+	    rearm(index);
+	}
+	expiring.clear();
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+   Synthetic CAN traffic for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "TrafficGenerator.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "can.hpp"
+
+TrafficGenerator::TrafficGenerator(const std::vector<GeneratorId>& mix, int min_length, int max_length, Payload payload,
+				   bool fd, bool brs)
+    : fd(fd), brs(brs), payload(payload), counter(0)
+{
+    unsigned long long total = 0;
+    for (const GeneratorId& id : mix)
+    {
+	if (!id.weight)
+	    continue;
+	total += id.weight;
+	ids.push_back(CanMessage::frameId(id.id));
+	cumulative.push_back(total);
+    }
+    if (ids.empty())
+    {
+	for (unsigned int id = 0x100; id < 0x200; ++id)
+	{
+	    ids.push_back(id);
+	    cumulative.push_back(++total);
+	}
+    }
+
+    int limit = fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+    this->min_length = std::min(std::max(min_length, 0), limit);
+    this->max_length = std::min(std::max(max_length, (int)this->min_length), limit);
+}
+
+bool TrafficGenerator::parsePayload(const std::string& name, Payload& payload)
+{
+    if (name == "random")
+	payload = Payload::Random;
+    else if (name == "zero")
+	payload = Payload::Zero;
+    else if (name == "counter")
+	payload = Payload::Counter;
+    else
+	return false;
+    return true;
+}
+
+int TrafficGenerator::next(canfd_frame& frame)
+{
+    memset(&frame, 0, sizeof(frame));
+
+    unsigned long long weight = random() % cumulative.back();
+    size_t index = std::upper_bound(cumulative.begin(), cumulative.end(), weight) - cumulative.begin();
+    frame.can_id = ids[index];
+    frame.len = min_length + random() % (max_length - min_length + 1);
+    if (fd)
+    {
+	frame.len = CanMessage::fdLength(CanMessage::fdDlc(frame.len));
+	frame.flags = CANFD_FDF | (brs ? CANFD_BRS : 0);
+    }
+
+    switch (payload)
+    {
+    case Payload::Random:
+	for (int i = 0; i < frame.len; ++i)
+	{
+	    frame.data[i] = random() & 0xff;
+	}
+	break;
+    case Payload::Zero:
+	break;
+    case Payload::Counter:
+	// little endian in the first 8 bytes, FD payload bytes after them stay zero
+	for (int i = 0; i < std::min<int>(frame.len, sizeof(counter)); ++i)
+	{
+	    frame.data[i] = (counter >> (8 * i)) & 0xff;
+	}
+	break;
+    }
+    ++counter;
+    return fd ? CANFD_MTU : CAN_MTU;
+}
+
+RateController::RateController(double target, double proportional_gain, double integral_gain)
+    : target(target), proportional_gain(proportional_gain), integral_gain(integral_gain), integral(0)
+{
+}
+
+double RateController::update(double achieved, double dt, bool saturated)
+{
+    double error = target - achieved;
+    if (!saturated)
+	integral += error * dt;
+    double command = target + proportional_gain * error + integral_gain * integral;
+    return command > 0 ? command : 0;
+}
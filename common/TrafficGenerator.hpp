@@ -0,0 +1,75 @@
+/*
+   Synthetic CAN traffic for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef TRAFFIC_GENERATOR_HPP
+#define TRAFFIC_GENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/can.h>
+
+#include "simulator.hpp"
+
+/*
+   Produces frames for load tests: identifiers are drawn from a weighted mix, payload
+   lengths evenly from a range, and payload bytes are random, zero or a running frame
+   number (so a consumer can spot lost frames). Frames are classic or CAN FD ones.
+*/
+class TrafficGenerator
+{
+public:
+    enum class Payload
+    {
+	Random,
+	Zero,
+	// running frame number, little endian in the first 8 bytes
+	Counter
+    };
+private:
+    std::vector<unsigned int> ids;
+    // running sum of the weights, searched with the drawn weight
+    std::vector<unsigned long long> cumulative;
+    unsigned int min_length;
+    unsigned int max_length;
+    bool fd;
+    bool brs;
+    Payload payload;
+    std::minstd_rand random;
+    unsigned long long counter;
+public:
+    TrafficGenerator(const std::vector<GeneratorId>& mix, int min_length, int max_length, Payload payload,
+		     bool fd = false, bool brs = false);
+
+    // parse "random", "zero" or "counter", returns false for anything else
+    static bool parsePayload(const std::string& name, Payload& payload);
+
+    // fill in the next frame, returns its MTU
+    int next(canfd_frame& frame);
+};
+
+/*
+   Proportional-integral control of a send rate.
+
+   The command is the target corrected by the error between target and achieved rate, so
+   timer slack and short stalls are made up for. The integral is frozen while the sender
+   is saturated, so a target above what the socket takes does not wind it up.
+*/
+class RateController
+{
+private:
+    double target;
+    double proportional_gain;
+    double integral_gain;
+    double integral;
+public:
+    RateController(double target, double proportional_gain = 0.2, double integral_gain = 2.0);
+
+    // rate to send at for the next interval, given the rate achieved over the last dt seconds
+    double update(double achieved, double dt, bool saturated);
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+   Batched CAN frame transmission for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "TxBatch.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+TxBatch::TxBatch(int socket, size_t capacity, std::chrono::microseconds deadline)
+    : can_socket(socket), capacity(capacity ? capacity : 1), pending(0), flushed(0), flush_deadline(deadline),
+      frames(this->capacity), iov(this->capacity), msgs(this->capacity),
+      frames_sent(0), syscalls(0)
+{
+    memset(msgs.data(), 0, msgs.size() * sizeof(mmsghdr));
+    for (size_t i = 0; i < this->capacity; ++i)
+    {
+	iov[i].iov_base = &frames[i];
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+bool TxBatch::queue(const canfd_frame& frame, int mtu)
+{
+    if (pending)
+    {
+	if (pending == capacity || std::chrono::steady_clock::now() - oldest >= flush_deadline)
+	{
+	    if (!flush())
+	    {
+		// the kernel queue is full, keep what it refused and take the frame if there is room
+		compact();
+		if (pending == capacity)
+		    return false;
+	    }
+	}
+    }
+    if (!pending)
+	oldest = std::chrono::steady_clock::now();
+
+    memcpy(&frames[pending], &frame, mtu);
+    iov[pending].iov_len = mtu;
+    ++pending;
+    return true;
+}
+
+void TxBatch::compact()
+{
+    if (!flushed)
+	return;
+    for (size_t i = flushed; i < pending; ++i)
+    {
+	memcpy(&frames[i - flushed], &frames[i], iov[i].iov_len);
+	iov[i - flushed].iov_len = iov[i].iov_len;
+    }
+    pending -= flushed;
+    flushed = 0;
+}
+
+bool TxBatch::flush()
+{
+    while (flushed < pending)
+    {
+	++syscalls;
+	int count = sendmmsg(can_socket, &msgs[flushed], pending - flushed, 0);
+	if (count < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+	    if (msgs[flushed + i].msg_len != iov[flushed + i].iov_len)
+	    {
+		errno = EMSGSIZE;
+		return false;
+	    }
+	}
+	flushed += count;
+	frames_sent += count;
+    }
+
+    pending = 0;
+    flushed = 0;
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+   Batched CAN frame transmission for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef TX_BATCH_HPP
+#define TX_BATCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*
+   Collects outgoing frames and hands them to the kernel with a single sendmmsg() call.
+
+   Frames are flushed when the batch is full, when the oldest queued frame is older than
+   the flush deadline, or when the owner calls flush() explicitly (typically once per tick).
+*/
+class TxBatch
+{
+private:
+    int can_socket;
+    size_t capacity;
+    size_t pending;
+    size_t flushed;
+    std::chrono::microseconds flush_deadline;
+    std::chrono::steady_clock::time_point oldest;
+
+    std::vector<canfd_frame> frames;
+    std::vector<iovec> iov;
+    std::vector<mmsghdr> msgs;
+
+    unsigned long long frames_sent;
+    unsigned long long syscalls;
+
+    // move the frames a failed flush left behind to the front of the batch
+    void compact();
+public:
+    TxBatch(int socket, size_t capacity, std::chrono::microseconds deadline);
+
+    /*
+       queue a frame, flushing first if the batch is full or its deadline has expired.
+       Returns false (with errno set) only if the frame could not be queued, because the
+       flush failed and left the batch full.
+    */
+    bool queue(const canfd_frame& frame, int mtu);
+    /*
+       send every queued frame, returns false (with errno set) if the kernel rejected a frame.
+       Frames the kernel already took are remembered, so a flush that failed with EAGAIN on a
+       non-blocking socket can simply be retried.
+    */
+    bool flush();
+
+    size_t size() const { return pending - flushed; }
+    unsigned long long framesSent() const { return frames_sent; }
+    unsigned long long syscallCount() const { return syscalls; }
+    double framesPerSyscall() const { return syscalls ? (double)frames_sent / syscalls : 0.0; }
+};
+
+#endif
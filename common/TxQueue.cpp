@@ -0,0 +1,241 @@
+/*
+   Bounded CAN frame transmit queue for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "TxQueue.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+TxQueue::TxQueue(size_t capacity, Overflow policy)
+    : entries(capacity ? capacity : 1), buckets(bucket_count, Bucket{ none, none }), delays(bucket_count),
+      bitmap(), summary(0), oldest(none), newest(none), count(0), policy(policy), statistics()
+{
+    free_entries.reserve(entries.size());
+    for (size_t i = entries.size(); i > 0; --i)
+    {
+	free_entries.push_back(i - 1);
+    }
+}
+
+bool TxQueue::parsePolicy(const std::string& name, Overflow& policy)
+{
+    if (name == "drop-oldest")
+	policy = Overflow::DropOldest;
+    else if (name == "drop-newest")
+	policy = Overflow::DropNewest;
+    else if (name == "block")
+	policy = Overflow::Block;
+    else
+	return false;
+    return true;
+}
+
+unsigned TxQueue::key(canid_t id)
+{
+    // the first 11 bits on the wire, then IDE (dominant for standard frames)
+    if (id & CAN_EFF_FLAG)
+	return (((id & CAN_EFF_MASK) >> 18) << 1) | 1;
+    return (id & CAN_SFF_MASK) << 1;
+}
+
+int TxQueue::first() const
+{
+    if (!summary)
+	return -1;
+    unsigned word = __builtin_ctzll(summary);
+    return word * 64 + __builtin_ctzll(bitmap[word]);
+}
+
+void TxQueue::append(unsigned bucket, unsigned index)
+{
+    Entry& entry = entries[index];
+    /*
+       Extended frames sharing a base identifier arbitrate on their remaining 18 bits, so they
+       are kept sorted by the full identifier. Walking from the tail keeps equal identifiers in
+       push order and costs nothing when they are pushed in ascending order.
+    */
+    unsigned previous = buckets[bucket].tail;
+    if (bucket & 1)
+    {
+	canid_t id = entry.frame.can_id & CAN_EFF_MASK;
+	while (previous != none && (entries[previous].frame.can_id & CAN_EFF_MASK) > id)
+	    previous = entries[previous].previous;
+    }
+
+    entry.previous = previous;
+    entry.next = previous == none ? buckets[bucket].head : entries[previous].next;
+    if (buckets[bucket].head == none)
+    {
+	bitmap[bucket / 64] |= 1ULL << (bucket % 64);
+	summary |= 1ULL << (bucket / 64);
+    }
+    if (previous == none)
+	buckets[bucket].head = index;
+    else
+	entries[previous].next = index;
+    if (entry.next == none)
+	buckets[bucket].tail = index;
+    else
+	entries[entry.next].previous = index;
+
+    entry.newer = none;
+    entry.older = newest;
+    if (newest == none)
+	oldest = index;
+    else
+	entries[newest].newer = index;
+    newest = index;
+}
+
+void TxQueue::unlink(unsigned bucket, unsigned index)
+{
+    const Entry& entry = entries[index];
+    if (entry.previous == none)
+	buckets[bucket].head = entry.next;
+    else
+	entries[entry.previous].next = entry.next;
+    if (entry.next == none)
+	buckets[bucket].tail = entry.previous;
+    else
+	entries[entry.next].previous = entry.previous;
+    if (buckets[bucket].head == none)
+    {
+	bitmap[bucket / 64] &= ~(1ULL << (bucket % 64));
+	if (!bitmap[bucket / 64])
+	    summary &= ~(1ULL << (bucket / 64));
+    }
+
+    if (entry.older == none)
+	oldest = entry.newer;
+    else
+	entries[entry.older].newer = entry.newer;
+    if (entry.newer == none)
+	newest = entry.older;
+    else
+	entries[entry.newer].older = entry.older;
+}
+
+bool TxQueue::push(const canfd_frame& frame, int mtu)
+{
+    if (full())
+    {
+	switch (policy)
+	{
+	case Overflow::DropOldest:
+	{
+	    unsigned index = oldest;
+	    unlink(key(entries[index].frame.can_id), index);
+	    free_entries.push_back(index);
+	    --count;
+	    ++statistics.dropped_oldest;
+	    break;
+	}
+	case Overflow::DropNewest:
+	    ++statistics.dropped_newest;
+	    return true;
+	case Overflow::Block:
+	    ++statistics.blocked;
+	    return false;
+	}
+    }
+
+    unsigned index = free_entries.back();
+    free_entries.pop_back();
+    Entry& entry = entries[index];
+    memcpy(&entry.frame, &frame, mtu);
+    entry.mtu = mtu;
+    entry.queued_at = std::chrono::steady_clock::now();
+    append(key(frame.can_id), index);
+
+    ++count;
+    ++statistics.pushed;
+    if (count > statistics.high_watermark)
+	statistics.high_watermark = count;
+    return true;
+}
+
+int TxQueue::drain(IoEngine& engine, BusPacer *pacer)
+{
+    int handed = 0;
+    auto now = std::chrono::steady_clock::now();
+    while (count)
+    {
+	unsigned bucket = first();
+	const Entry& entry = entries[buckets[bucket].head];
+	if (pacer && !pacer->ready())
+	    break;
+	if (!engine.queue(entry.frame, entry.mtu))
+	{
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+		return -1;
+	    break;
+	}
+	// steady_clock is CLOCK_MONOTONIC, the clock the pacer runs on
+	if (pacer)
+	    pacer->transmit(entry.frame, entry.mtu, std::chrono::duration_cast<std::chrono::nanoseconds>(entry.queued_at.time_since_epoch()).count());
+
+	long long waited = std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.queued_at).count();
+	Delay& delay = delays[bucket];
+	++delay.frames;
+	delay.total += waited;
+	if (waited > delay.max)
+	    delay.max = waited;
+
+	unsigned index = buckets[bucket].head;
+	unlink(bucket, index);
+	free_entries.push_back(index);
+	--count;
+	++handed;
+    }
+
+    if (engine.pending() && !engine.flush())
+    {
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+	    return -1;
+    }
+    return handed;
+}
+
+void TxQueue::printStatistics(std::ostream& out) const
+{
+    out << "TX queue: " << count << "/" << entries.size() << " queued, high watermark "
+	<< statistics.high_watermark << ", " << statistics.dropped_oldest << " dropped oldest, "
+	<< statistics.dropped_newest << " dropped newest, " << statistics.blocked << " blocked" << std::endl;
+
+    /*
+       in arbitration order, so the identifiers that win the bus are listed first. The delay is
+       the time until the frame was handed to the I/O engine, not until it was sent
+    */
+    out << "TX delay until hand-off to the I/O engine, per base identifier:" << std::endl;
+    size_t listed = 0;
+    Delay remaining = {};
+    size_t remaining_keys = 0;
+    for (unsigned bucket = 0; bucket < bucket_count; ++bucket)
+    {
+	const Delay& delay = delays[bucket];
+	if (!delay.frames)
+	    continue;
+	if (listed >= listed_delays)
+	{
+	    remaining.frames += delay.frames;
+	    remaining.total += delay.total;
+	    if (delay.max > remaining.max)
+		remaining.max = delay.max;
+	    ++remaining_keys;
+	    continue;
+	}
+
+	out << "TX delay 0x" << std::hex << (bucket >> 1) << std::dec << ((bucket & 1) ? " (extended)" : "") << ": "
+	    << delay.frames << " frames, avg " << (double)delay.total / delay.frames / 1000.0
+	    << " us, max " << delay.max / 1000.0 << " us" << std::endl;
+	++listed;
+    }
+
+    if (remaining_keys)
+    {
+	out << "TX delay (" << remaining_keys << " more): " << remaining.frames << " frames, avg "
+	    << (double)remaining.total / remaining.frames / 1000.0 << " us, max " << remaining.max / 1000.0 << " us" << std::endl;
+    }
+}
@@ -0,0 +1,136 @@
+/*
+   Bounded CAN frame transmit queue for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef TX_QUEUE_HPP
+#define TX_QUEUE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <linux/can.h>
+
+#include "BusTiming.hpp"
+#include "IoEngine.hpp"
+
+/*
+   Holds outgoing frames until they are handed to the socket, in CAN arbitration order.
+
+   A bus sends the frame with the lowest identifier first, so drain() always takes the
+   queued frame with the highest priority. Frames are kept in one bucket per arbitration
+   key: the 11-bit base identifier, followed by the IDE bit, so a standard frame wins
+   against an extended frame with the same base identifier. A two level bitmap over the
+   4096 buckets finds the first non-empty one with two find-first-set instructions.
+   Extended frames sharing a base identifier are sorted by their full identifier within
+   the bucket, repeats of one identifier leave in the order they were pushed.
+
+   The order only holds for the frames still in this queue. Frames drain() has handed to
+   the I/O engine (up to its batch size) are on their way to the socket and can no longer
+   be overtaken by a lower identifier pushed later.
+
+   When the queue is full, the overflow policy decides: drop the frame that was pushed
+   first, whatever its identifier (drop-oldest), drop the new frame (drop-newest), or
+   refuse it so the owner can wait for the socket (block). Every outcome is counted, and
+   the time every frame spent queued, up to its hand-off to the engine, is accumulated
+   per arbitration key.
+*/
+class TxQueue
+{
+public:
+    enum class Overflow
+    {
+	DropOldest,
+	DropNewest,
+	Block
+    };
+
+    struct Statistics
+    {
+	unsigned long long pushed;
+	unsigned long long dropped_oldest;
+	unsigned long long dropped_newest;
+	unsigned long long blocked;
+	size_t high_watermark;
+    };
+private:
+    static constexpr unsigned bucket_count = 4096;
+    static constexpr unsigned word_count = bucket_count / 64;
+    static constexpr unsigned none = ~0u;
+    // only this many identifiers are listed one by one in printStatistics(), the rest are summarized
+    static constexpr size_t listed_delays = 16;
+
+    struct Entry
+    {
+	canfd_frame frame;
+	int mtu;
+	// neighbours within the bucket
+	unsigned next;
+	unsigned previous;
+	// neighbours in push order, across all buckets
+	unsigned older;
+	unsigned newer;
+	std::chrono::steady_clock::time_point queued_at;
+    };
+
+    struct Bucket
+    {
+	unsigned head;
+	unsigned tail;
+    };
+
+    struct Delay
+    {
+	unsigned long long frames;
+	long long total;          // nanoseconds
+	long long max;            // nanoseconds
+    };
+
+    std::vector<Entry> entries;
+    std::vector<unsigned> free_entries;
+    std::vector<Bucket> buckets;
+    std::vector<Delay> delays;
+    uint64_t bitmap[word_count];
+    uint64_t summary;
+    unsigned oldest;
+    unsigned newest;
+    size_t count;
+    Overflow policy;
+    Statistics statistics;
+
+    static unsigned key(canid_t id);
+    int first() const;
+    void append(unsigned bucket, unsigned index);
+    void unlink(unsigned bucket, unsigned index);
+public:
+    TxQueue(size_t capacity, Overflow policy);
+
+    // parse "drop-oldest", "drop-newest" or "block", returns false for anything else
+    static bool parsePolicy(const std::string& name, Overflow& policy);
+
+    /*
+       queue a frame. Returns false only if the queue is full and the policy is block,
+       the owner then has to drain() the queue and push the frame again.
+    */
+    bool push(const canfd_frame& frame, int mtu);
+    /*
+       hand queued frames to the engine, highest priority first, until it refuses one (or
+       the pacer, if given, finds the simulated bus busy), then flush the engine. Returns
+       the number of frames handed over, or -1 (with errno set) on an error other than a
+       full socket.
+    */
+    int drain(IoEngine& engine, BusPacer *pacer = nullptr);
+
+    bool empty() const { return !count; }
+    bool full() const { return count == entries.size(); }
+    size_t size() const { return count; }
+    Overflow overflow() const { return policy; }
+
+    void printStatistics(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,517 @@
+/*
+   io_uring based CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "UringEngine.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+UringEngine::UringEngine(int socket, size_t rx_depth, size_t tx_depth, std::chrono::microseconds deadline)
+    : IoEngine(socket), ring_fd(-1), sq_ring(nullptr), sq_ring_size(0), cq_ring(nullptr), cq_ring_size(0),
+      sqes(nullptr), sq_local_tail(0), to_submit(0),
+      rx_depth(rx_depth ? rx_depth : 1), multishot(false), rx_armed(false),
+      buffer_ring(nullptr), buffer_ring_size(0), buffer_count(0), buffer_tail(0),
+      buffer_size(sizeof(io_uring_recvmsg_out) + control_size + sizeof(canfd_frame)),
+      frames(this->rx_depth), received_count(0), rx_error(0),
+      tx_depth(tx_depth ? tx_depth : 1), flush_deadline(deadline), fixed_buffers(false),
+      tx_frames(this->tx_depth), tx_lengths(this->tx_depth), tx_sequence(this->tx_depth), next_sequence(0),
+      queued(0), last_send(nullptr), tx_error(0), epoll_fd(-1),
+      frames_sent(0), frames_received(0), syscalls(0)
+{
+    memset(&params, 0, sizeof(params));
+    memset(&multishot_msg, 0, sizeof(multishot_msg));
+    memset(frames.data(), 0, frames.size() * sizeof(ReceivedFrame));
+    batch = frames.data();
+
+    // slots are handed out from the back, so the first sends use the lowest slots
+    for (size_t i = this->tx_depth; i > 0; --i)
+    {
+	free_slots.push_back(i - 1);
+    }
+}
+
+UringEngine::~UringEngine()
+{
+    if (epoll_fd >= 0)
+	close(epoll_fd);
+    if (buffer_ring)
+	munmap(buffer_ring, buffer_ring_size);
+    if (sqes)
+	munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+    if (cq_ring && cq_ring != sq_ring)
+	munmap(cq_ring, cq_ring_size);
+    if (sq_ring)
+	munmap(sq_ring, sq_ring_size);
+    if (ring_fd >= 0)
+	close(ring_fd);
+}
+
+bool UringEngine::open()
+{
+    // every receive slot and every send slot may be in flight at the same time
+    ring_fd = syscall(__NR_io_uring_setup, rx_depth + tx_depth, &params);
+    if (ring_fd < 0)
+	return false;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+	sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    void *ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED)
+	return false;
+    sq_ring = (unsigned char *)ring;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+	cq_ring = sq_ring;
+    }
+    else
+    {
+	ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	if (ring == MAP_FAILED)
+	    return false;
+	cq_ring = (unsigned char *)ring;
+    }
+
+    ring = mmap(NULL, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ring_fd, IORING_OFF_SQES);
+    if (ring == MAP_FAILED)
+	return false;
+    sqes = (io_uring_sqe *)ring;
+
+    sq_head = (unsigned *)(sq_ring + params.sq_off.head);
+    sq_tail = (unsigned *)(sq_ring + params.sq_off.tail);
+    sq_mask = (unsigned *)(sq_ring + params.sq_off.ring_mask);
+    sq_array = (unsigned *)(sq_ring + params.sq_off.array);
+    cq_head = (unsigned *)(cq_ring + params.cq_off.head);
+    cq_tail = (unsigned *)(cq_ring + params.cq_off.tail);
+    cq_mask = (unsigned *)(cq_ring + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    sq_local_tail = *sq_tail;
+
+    // the send pool is pinned once, so sends do not have to map user pages every time
+    iovec pool = { tx_frames.data(), tx_frames.size() * sizeof(canfd_frame) };
+    fixed_buffers = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &pool, 1) == 0;
+
+    multishot = setupBufferRing();
+    if (!multishot)
+	setupSlots();
+    return true;
+}
+
+void UringEngine::setupSlots()
+{
+    slot_frames.resize(rx_depth);
+    slot_iov.resize(rx_depth);
+    slot_msgs.resize(rx_depth);
+    slot_control.resize(rx_depth * control_size);
+    memset(slot_msgs.data(), 0, slot_msgs.size() * sizeof(msghdr));
+    for (size_t i = 0; i < rx_depth; ++i)
+    {
+	slot_iov[i].iov_base = &slot_frames[i];
+	slot_iov[i].iov_len = sizeof(canfd_frame);
+	slot_msgs[i].msg_iov = &slot_iov[i];
+	slot_msgs[i].msg_iovlen = 1;
+	slot_msgs[i].msg_control = &slot_control[i * control_size];
+    }
+}
+
+bool UringEngine::setupBufferRing()
+{
+    // a few batches, so a burst can be buffered while the previous batch is decoded
+    buffer_count = 1;
+    while (buffer_count < 4 * rx_depth && buffer_count < 32768)
+	buffer_count <<= 1;
+
+    buffer_ring_size = buffer_count * sizeof(io_uring_buf);
+    void *ring = mmap(NULL, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+	buffer_ring = nullptr;
+	return false;
+    }
+    buffer_ring = (io_uring_buf_ring *)ring;
+
+    io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (__u64)(unsigned long)buffer_ring;
+    registration.ring_entries = buffer_count;
+    registration.bgid = 0;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+	munmap(buffer_ring, buffer_ring_size);
+	buffer_ring = nullptr;
+	return false;
+    }
+
+    buffers.resize(buffer_count * buffer_size);
+    for (unsigned i = 0; i < buffer_count; ++i)
+    {
+	recycleBuffer(i);
+    }
+    __atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+
+    // no source address, only the control messages and the frame land in the buffer
+    multishot_msg.msg_controllen = control_size;
+    return true;
+}
+
+void UringEngine::recycleBuffer(unsigned short id)
+{
+    // entries start at the ring itself, the tail overlays the reserved field of the first one
+    // (bufs[] cannot be used from C++, where the empty struct in front of it takes space)
+    io_uring_buf *buffer = (io_uring_buf *)buffer_ring + (buffer_tail & (buffer_count - 1));
+    buffer->addr = (__u64)(unsigned long)&buffers[id * buffer_size];
+    buffer->len = buffer_size;
+    buffer->bid = id;
+    ++buffer_tail;
+}
+
+io_uring_sqe* UringEngine::nextSqe()
+{
+    // submit what is queued if the kernel has not consumed enough entries yet
+    if (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries)
+    {
+	if (!enter(0))
+	    return nullptr;
+    }
+
+    unsigned index = sq_local_tail & *sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sq_local_tail;
+    ++to_submit;
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+bool UringEngine::enter(unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int count;
+    do
+    {
+	++syscalls;
+	count = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0)
+	return false;
+    to_submit -= count;
+    return true;
+}
+
+void UringEngine::reap()
+{
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned short posted = buffer_tail;
+
+    while (head != tail)
+    {
+	if (!complete(cqes[head & *cq_mask]))
+	    break;
+	++head;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+    if (buffer_tail != posted)
+	__atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+}
+
+bool UringEngine::complete(const io_uring_cqe& cqe)
+{
+    if (cqe.user_data & tx_tag)
+    {
+	unsigned slot = cqe.user_data & ~tx_tag;
+	// refused by a full queue, or cancelled because an earlier frame of the chain was
+	if (cqe.res == -EAGAIN || cqe.res == -ENOBUFS || cqe.res == -ECANCELED)
+	{
+	    retry.push_back(slot);
+	    if (cqe.res != -ECANCELED)
+		tx_error = -cqe.res;
+	    return true;
+	}
+
+	free_slots.push_back(slot);
+	if (cqe.res < 0)
+	    tx_error = -cqe.res;
+	else if ((unsigned)cqe.res != tx_lengths[slot])
+	    tx_error = EMSGSIZE;
+	else
+	    ++frames_sent;
+	return true;
+    }
+
+    // a full batch leaves the remaining frames for the next receive()
+    if (received_count == frames.size())
+	return false;
+
+    if (cqe.user_data & multishot_tag)
+	completeMultishot(cqe);
+    else
+	completeSlot(cqe);
+    return true;
+}
+
+void UringEngine::completeMultishot(const io_uring_cqe& cqe)
+{
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+	rx_armed = false;
+
+    if (cqe.res < 0)
+    {
+	// out of buffers, the receive is simply armed again once some were given back
+	if (cqe.res == -ENOBUFS)
+	    return;
+	// kernels with buffer rings but without multishot recvmsg refuse the request
+	if (cqe.res == -EINVAL && !frames_received && !received_count)
+	{
+	    multishot = false;
+	    setupSlots();
+	    armSlots();
+	    return;
+	}
+	rx_error = -cqe.res;
+	return;
+    }
+
+    if (!(cqe.flags & IORING_CQE_F_BUFFER))
+	return;
+    unsigned short id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    unsigned char *buffer = &buffers[id * buffer_size];
+    io_uring_recvmsg_out *out = (io_uring_recvmsg_out *)buffer;
+    size_t header = sizeof(io_uring_recvmsg_out) + multishot_msg.msg_namelen + multishot_msg.msg_controllen;
+
+    if ((size_t)cqe.res >= header)
+    {
+	ReceivedFrame& received = frames[received_count++];
+	size_t length = std::min<size_t>(out->payloadlen, cqe.res - header);
+	memcpy(&received.frame, buffer + header, std::min(length, sizeof(canfd_frame)));
+	received.length = out->payloadlen;
+
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = buffer + sizeof(io_uring_recvmsg_out) + multishot_msg.msg_namelen;
+	msg.msg_controllen = out->controllen;
+	RxBatch::readControl(&msg, received.timestamp, kernel_drops);
+    }
+    recycleBuffer(id);
+}
+
+void UringEngine::completeSlot(const io_uring_cqe& cqe)
+{
+    unsigned slot = cqe.user_data;
+    if (cqe.res < 0)
+    {
+	rx_error = -cqe.res;
+	return;
+    }
+
+    ReceivedFrame& received = frames[received_count++];
+    memcpy(&received.frame, &slot_frames[slot], sizeof(canfd_frame));
+    received.length = cqe.res;
+    RxBatch::readControl(&slot_msgs[slot], received.timestamp, kernel_drops);
+    postSlot(slot);
+}
+
+void UringEngine::armMultishot()
+{
+    io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+	return;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = can_socket;
+    sqe->addr = (__u64)(unsigned long)&multishot_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = multishot_tag;
+    rx_armed = true;
+}
+
+void UringEngine::armSlots()
+{
+    for (size_t i = 0; i < rx_depth; ++i)
+    {
+	postSlot(i);
+    }
+    rx_armed = true;
+}
+
+void UringEngine::postSlot(unsigned slot)
+{
+    // the kernel overwrites these on every receive, so they have to be reset
+    slot_msgs[slot].msg_controllen = control_size;
+    slot_msgs[slot].msg_flags = 0;
+
+    io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+	return;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = can_socket;
+    sqe->addr = (__u64)(unsigned long)&slot_msgs[slot];
+    sqe->len = 1;
+    sqe->user_data = slot;
+}
+
+bool UringEngine::prepareSend(unsigned slot)
+{
+    io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+	return false;
+
+    sqe->opcode = fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_SEND;
+    sqe->fd = can_socket;
+    sqe->addr = (__u64)(unsigned long)&tx_frames[slot];
+    sqe->len = tx_lengths[slot];
+    sqe->buf_index = 0;
+    // io_uring would otherwise poll a full socket until it has room, even a non-blocking one
+    if (fixed_buffers)
+	sqe->rw_flags = RWF_NOWAIT;
+    else
+	sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = tx_tag | slot;
+    // linked, so a send that has to wait for socket buffer space cannot be overtaken
+    sqe->flags = IOSQE_IO_LINK;
+    last_send = sqe;
+    ++queued;
+    return true;
+}
+
+bool UringEngine::queue(const canfd_frame& frame, int mtu)
+{
+    if (queued)
+    {
+	if (queued == tx_depth || std::chrono::steady_clock::now() - oldest >= flush_deadline)
+	{
+	    // the frame still fits if the kernel took at least part of the queue, a real send error does not wait
+	    if (!flush() && (free_slots.empty() || (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)))
+		return false;
+	}
+    }
+    if (free_slots.empty())
+    {
+	errno = ENOBUFS;
+	return false;
+    }
+
+    unsigned slot = free_slots.back();
+    free_slots.pop_back();
+    memcpy(&tx_frames[slot], &frame, mtu);
+    tx_lengths[slot] = mtu;
+    tx_sequence[slot] = next_sequence++;
+
+    if (!queued)
+	oldest = std::chrono::steady_clock::now();
+    if (!prepareSend(slot))
+    {
+	free_slots.push_back(slot);
+	return false;
+    }
+    return true;
+}
+
+bool UringEngine::flush()
+{
+    // submit the chain and wait for it in the same call, the next flush starts a new chain
+    if (queued)
+    {
+	last_send->flags &= ~IOSQE_IO_LINK;
+	if (!enter(queued))
+	    return false;
+	queued = 0;
+    }
+    else if (to_submit && !enter(0))
+    {
+	return false;
+    }
+
+    reap();
+
+    // refused frames stay queued, in their original order, for the next flush
+    if (!retry.empty())
+    {
+	std::sort(retry.begin(), retry.end(), [this](unsigned a, unsigned b) { return tx_sequence[a] < tx_sequence[b]; });
+	oldest = std::chrono::steady_clock::now();
+	size_t prepared = 0;
+	while (prepared < retry.size() && prepareSend(retry[prepared]))
+	    ++prepared;
+	retry.erase(retry.begin(), retry.begin() + prepared);
+	// no free submission entry, the rest stays in retry (not leaked) for the next flush,
+	// reported as the same backpressure a full socket buffer is
+	if (!retry.empty())
+	{
+	    errno = ENOBUFS;
+	    return false;
+	}
+    }
+
+    if (tx_error)
+    {
+	errno = tx_error;
+	tx_error = 0;
+	return false;
+    }
+    return true;
+}
+
+bool UringEngine::waitWritable(std::chrono::microseconds timeout)
+{
+    if (epoll_fd < 0)
+    {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event event;
+	event.events = EPOLLOUT | EPOLLET;
+	event.data.fd = can_socket;
+	if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, can_socket, &event) < 0)
+	    return false;
+    }
+
+    epoll_event event;
+    ++syscalls;
+    return epoll_wait(epoll_fd, &event, 1, (timeout.count() + 999) / 1000) >= 0 || errno == EINTR;
+}
+
+int UringEngine::receive()
+{
+    received_count = 0;
+    while (true)
+    {
+	reap();
+	if (rx_error)
+	{
+	    errno = rx_error;
+	    rx_error = 0;
+	    return -1;
+	}
+	if (received_count)
+	    break;
+
+	// nothing is pending here, so every buffer is back in the ring before re-arming
+	if (!rx_armed)
+	{
+	    if (multishot)
+		armMultishot();
+	    else
+		armSlots();
+	}
+	if (!enter(1))
+	    return -1;
+    }
+
+    frames_received += received_count;
+    return received_count;
+}
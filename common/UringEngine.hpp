@@ -0,0 +1,132 @@
+/*
+   io_uring based CAN socket I/O for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef URING_ENGINE_HPP
+#define URING_ENGINE_HPP
+
+#include <chrono>
+#include <vector>
+
+#include <linux/errqueue.h>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "IoEngine.hpp"
+
+/*
+   io_uring backend, driven through the raw system calls (no liburing).
+
+   Sends are prepared as submission queue entries straight from a frame pool that is
+   registered with the kernel (IORING_OP_WRITE_FIXED). They are linked, so frames leave
+   in the order they were queued, and one io_uring_enter() both submits the whole queue
+   and waits for it. On a non-blocking socket, frames the kernel refuses (and the ones
+   linked behind them) are kept and prepared again for the next flush.
+
+   Receiving uses a single multishot IORING_OP_RECVMSG that keeps filling
+   buffers from a provided buffer ring, so a busy socket costs no submission at all and
+   receive() only enters the kernel when the completion queue is empty. Kernels without
+   provided buffer rings or multishot recvmsg get one posted recvmsg per frame slot
+   instead, and kernels that refuse buffer registration get plain IORING_OP_SEND.
+*/
+class UringEngine : public IoEngine
+{
+private:
+    static constexpr size_t control_size = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(__u32));
+    // user_data tags, the low bits carry the frame slot
+    static constexpr __u64 tx_tag = 1ULL << 63;
+    static constexpr __u64 multishot_tag = 1ULL << 62;
+
+    int ring_fd;
+    io_uring_params params;
+    unsigned char *sq_ring;
+    size_t sq_ring_size;
+    unsigned char *cq_ring;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    io_uring_cqe *cqes;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+
+    // receive side
+    size_t rx_depth;
+    bool multishot;
+    bool rx_armed;
+    msghdr multishot_msg;
+    io_uring_buf_ring *buffer_ring;
+    size_t buffer_ring_size;
+    unsigned buffer_count;
+    unsigned short buffer_tail;
+    size_t buffer_size;
+    std::vector<unsigned char> buffers;
+    std::vector<canfd_frame> slot_frames;
+    std::vector<iovec> slot_iov;
+    std::vector<msghdr> slot_msgs;
+    std::vector<char> slot_control;
+    std::vector<ReceivedFrame> frames;
+    size_t received_count;
+    int rx_error;
+
+    // send side
+    size_t tx_depth;
+    std::chrono::microseconds flush_deadline;
+    std::chrono::steady_clock::time_point oldest;
+    bool fixed_buffers;
+    std::vector<canfd_frame> tx_frames;
+    std::vector<unsigned> tx_lengths;
+    std::vector<unsigned long long> tx_sequence;
+    unsigned long long next_sequence;
+    std::vector<unsigned> free_slots;
+    std::vector<unsigned> retry;
+    size_t queued;
+    io_uring_sqe *last_send;
+    int tx_error;
+    int epoll_fd;
+
+    unsigned long long frames_sent;
+    unsigned long long frames_received;
+    unsigned long long syscalls;
+
+    io_uring_sqe* nextSqe();
+    bool enter(unsigned min_complete);
+    void reap();
+    bool complete(const io_uring_cqe& cqe);
+    void completeMultishot(const io_uring_cqe& cqe);
+    void completeSlot(const io_uring_cqe& cqe);
+    void armMultishot();
+    void setupSlots();
+    void armSlots();
+    void postSlot(unsigned slot);
+    bool prepareSend(unsigned slot);
+    void recycleBuffer(unsigned short id);
+    bool setupBufferRing();
+public:
+    UringEngine(int socket, size_t rx_depth, size_t tx_depth, std::chrono::microseconds deadline);
+    ~UringEngine();
+
+    // create the rings and register buffers, returns false if io_uring cannot be used
+    bool open();
+
+    const char* name() const { return "uring"; }
+
+    bool queue(const canfd_frame& frame, int mtu);
+    bool flush();
+    int receive();
+    size_t pending() const { return queued; }
+    bool waitWritable(std::chrono::microseconds timeout);
+
+    unsigned long long framesSent() const { return frames_sent; }
+    unsigned long long framesReceived() const { return frames_received; }
+    unsigned long long syscallCount() const { return syscalls; }
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+   Signal layout of the vehicle messages for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#include "VehicleMessage.hpp"
+
+#include <algorithm>
+
+#include "can.hpp"
+
+DbcMessage vehicleMessage(const MessageLayout& layout, VehicleSignal signal)
+{
+    DbcMessage message;
+    message.id = CanMessage::frameId(layout.id);
+    message.length = std::max(layout.length, layout.frame_length);
+
+    DbcSignal value = { "", layout.position * 8, 8, false, false, 1, 0, 0, 0, "", DbcSignal::Plain, 0 };
+    switch (signal)
+    {
+    case VehicleSignal::Door:
+	message.name = value.name = "door";
+	break;
+    case VehicleSignal::TurnSignal:
+	message.name = value.name = "signal";
+	break;
+    case VehicleSignal::Speed:
+	// Motorola start bit, the most significant bit of the first byte
+	message.name = value.name = "speed";
+	value.start_bit = layout.position * 8 + 7;
+	value.length = 16;
+	value.big_endian = true;
+	break;
+    case VehicleSignal::Diagnostic:
+	// the whole classic payload, wherever the signal position points
+	message.name = value.name = "diagnostic";
+	message.length = 8;
+	value.start_bit = 0;
+	value.length = 64;
+	value.is_signed = true;
+	break;
+    }
+    message.signals.push_back(value);
+    return message;
+}
@@ -0,0 +1,27 @@
+/*
+   Signal layout of the vehicle messages for car CAN bus simulator
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef VEHICLE_MESSAGE_HPP
+#define VEHICLE_MESSAGE_HPP
+
+#include "SignalDatabase.hpp"
+#include "SimulationConfig.hpp"
+
+enum class VehicleSignal
+{
+    Door,          // one byte, a bit per door
+    TurnSignal,    // one byte, a bit per turn signal
+    Speed,         // two bytes big endian, hundredths of km/h
+    Diagnostic     // eight bytes little endian, signed CLOCK_REALTIME transmit time in nanoseconds
+};
+
+/*
+   A configured vehicle message as a DBC message with its one signal, placed at the
+   configured position. The controller encodes, the console decodes and codegen bakes the
+   vehicle messages from this layout, so they always agree.
+*/
+DbcMessage vehicleMessage(const MessageLayout& layout, VehicleSignal signal);
+
+#endif
@@ -5,38 +5,43 @@
 #ifndef CAN_HPP
 #define CAN_HPP
 
-struct CanMessage final
+#include <vector>
+
+// a frame that is sent periodically (or once, without a period) on behalf of the rest of the vehicle
+struct PeriodicFrame
 {
-    struct ID final
-    {
-        inline static int Door = 411;
-        inline static int Signal = 392;
-        inline static int Speed = 580;
-    };
+    int id;
+    int length;
+    int period;   // milliseconds, 0 sends the frame once
+    int offset;   // milliseconds
+    bool fd;      // sent as a CAN FD frame, length may then be up to 64 bytes
+    bool brs;     // CAN FD bit rate switch
+    std::vector<unsigned char> data;
+};
 
-    struct Position final
+struct CanMessage final
+{
+    // configured ids above the 11-bit range are sent and matched as extended (29-bit) frame ids
+    static unsigned int frameId(int id)
     {
-        inline static int Door = 2;
-        inline static int Signal = 0;
-        inline static int Speed = 3;
-    };
+	return (unsigned int)id > 0x7ff ? (id & 0x1fffffff) | 0x80000000u : id;
+    }
 
-    struct Length final
+    // payload length a CAN FD data length code stands for
+    static unsigned char fdLength(unsigned char dlc)
     {
-        inline static int Door = Position::Door + 1;
-        inline static int Signal = Position::Door + 1;
-        inline static int Speed = Position::Speed + 2;
-    };
+	static const unsigned char lengths[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+	return lengths[dlc & 0xf];
+    }
 
-    struct Equipment final
+    // CAN FD data length code for a payload length, lengths between two codes round up
+    static unsigned char fdDlc(unsigned char length)
     {
-        inline static int LeftSignal = 1;
-        inline static int RightSignal = 2;
-        inline static int Door1 = 1;
-        inline static int Door2 = 2;
-        inline static int Door3 = 4;
-        inline static int Door4 = 8;
-    };
+	unsigned char dlc = 0;
+	while (dlc < 15 && fdLength(dlc) < length)
+	    ++dlc;
+	return dlc;
+    }
 };
 
 #endif
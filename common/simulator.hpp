@@ -0,0 +1,22 @@
+/*
+   Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
+*/
+
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+// an additional acceptance filter for the console socket, matches when (id & mask) == (frame id & mask)
+struct FilterMask
+{
+    unsigned int id;
+    unsigned int mask;
+};
+
+// one identifier of the traffic generator mix, picked with a probability proportional to its weight
+struct GeneratorId
+{
+    unsigned int id;
+    unsigned int weight;
+};
+
+#endif
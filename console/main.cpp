@@ -3,15 +3,29 @@
    Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
 */
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
 #include <net/if.h>
 #include <signal.h>
 #include <sys/ioctl.h>
@@ -21,30 +35,111 @@
 #include <unistd.h>
 
 #include "../common/can.hpp"
-#include "../common/car.hpp"
 #include "../common/ConfigurationParser.hpp"
+#include "../common/DecodePlan.hpp"
+#include "../common/DispatchTable.hpp"
+#include "../common/IoEngine.hpp"
+#include "../common/LatencyHistogram.hpp"
+#include "../common/MessageDecoder.hpp"
+#include "../common/MetricsFile.hpp"
+#include "../common/PacketRing.hpp"
+#include "../common/RxBatch.hpp"
+#include "../common/SignalDatabase.hpp"
+#include "../common/SimulationConfig.hpp"
+#include "../common/SpscRing.hpp"
+#include "../common/VehicleMessage.hpp"
+
+#ifdef SIMULATOR_BAKED_LAYOUT
+#include "BakedLayout.hpp"
+#endif
 
 class Console
 {
 private:
-    int door_status[4];
-    int turn_status[2];
-    long current_speed;
-    int maxdlen;
+    // this console's own copy, only the message randomization at startup writes to it
+    SimulationConfig config;
+    /*
+       Vehicle state snapshot. The receive path only stores into it and bumps state_version,
+       the render thread redraws the dashboard from it at the configured refresh rate.
+    */
+    std::atomic<int> door_status[4];
+    std::atomic<int> turn_status[2];
+    std::atomic<long> current_speed;
+    std::atomic<unsigned long> state_version;
     int randomize;
     int seed;
 
-    struct timeval tv;
+    // latency histograms are filled by a decoder thread and printed by the receive thread
+    std::mutex latency_lock;
+    LatencyHistogram wire_latency;
+    LatencyHistogram decode_latency;
+    LatencyHistogram end_to_end_latency;
 
     int can_socket;
     int enable_canfd;
     ifreq ifr;
     sockaddr_can addr;
-    iovec iov;
-    msghdr msg;
-    cmsghdr *cmsg;
-    canfd_frame can_frame;
-    char ctrlmsg[CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(__u32))];
+
+    // exactly one of these captures frames, depending on the configured capture mode
+    std::unique_ptr<IoEngine> io_engine;
+    std::unique_ptr<PacketRing> packet_ring;
+    typedef void (Console::*Handler)(const ReceivedFrame&);
+    DispatchTable<Handler> dispatch_table;
+    // vehicle messages configured with the same id all decode its frames, through dispatchShared()
+    std::unordered_map<canid_t, std::vector<Handler>> shared_handlers;
+    // layouts of the vehicle messages, compiled like DBC messages
+    DecodePlan door_plan;
+    DecodePlan signal_plan;
+    DecodePlan speed_plan;
+    DecodePlan diagnostic_plan;
+
+    /*
+       Messages of the configured DBC file, multiplexed ones included. Frames of one id are
+       always decoded by the same thread, the latest physical value of every signal is kept
+       for the metrics.
+    */
+    struct DatabaseDecoder
+    {
+	const DbcMessage *message;
+	MessageDecoder layout;
+	std::vector<double> scratch;
+	std::unique_ptr<std::atomic<double>[]> values;
+	std::atomic<unsigned long long> frames;
+
+	explicit DatabaseDecoder(const DbcMessage& definition)
+	    : message(&definition), layout(definition), scratch(layout.size()),
+	      values(new std::atomic<double>[layout.size()]()), frames(0) {}
+    };
+    SignalDatabase database;
+    std::vector<std::unique_ptr<DatabaseDecoder>> database_decoders;
+    DispatchTable<DatabaseDecoder*> database_table;
+    unsigned long long kernel_drops;
+    // frames received per can_id, standard ids are indexed directly
+    std::vector<unsigned long long> id_frames;
+    std::unordered_map<canid_t, unsigned long long> extended_id_frames;
+    // CAN FD frames among the received ones, and the payload bytes of all of them
+    unsigned long long fd_frames;
+    unsigned long long payload_bytes;
+    std::unique_ptr<MetricsFile> metrics;
+
+    /*
+       Receive/decode pipeline. The receive thread only drains the socket and hands every
+       frame to the decoder that owns its id (so frames of one id stay in order). A full ring
+       makes the receive thread wait up to the backpressure timeout before the frame is
+       dropped, so short bursts are absorbed in user space instead of the socket queue.
+    */
+    struct Decoder
+    {
+	SpscRing<ReceivedFrame> ring;
+	std::atomic<unsigned long long> decoded;
+
+	explicit Decoder(size_t capacity) : ring(capacity), decoded(0) {}
+    };
+    std::vector<std::unique_ptr<Decoder>> decoders;
+    unsigned long long backpressure_stalls;
+    unsigned long long ring_overflows;
+    unsigned long long bus_frames_at_start;
+    std::chrono::steady_clock::time_point last_report_time;
 protected:
     void initialize_can_socket(const char* name)
     {
@@ -69,58 +164,275 @@ protected:
             exit(-4);
         }
 
-	iov.iov_base = &can_frame;
-	iov.iov_len = sizeof(can_frame);
-	msg.msg_name = &addr;
-	msg.msg_namelen = sizeof(addr);
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	msg.msg_control = &ctrlmsg;
-	msg.msg_controllen = sizeof(ctrlmsg);
-	msg.msg_flags = 0;
-
 	if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
         {
             std::cerr << "Error: Cannot bind to CAN socket" << std::endl;
             exit(-5);
         }
 
+	int rxq_overflow = 1;
+	if (setsockopt(can_socket, SOL_SOCKET, SO_RXQ_OVFL, &rxq_overflow, sizeof(rxq_overflow)))
+	{
+	    std::cerr << "Error: Cannot enable CAN drop monitoring" << std::endl;
+	    exit(-10);
+	}
+
+	int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	if (setsockopt(can_socket, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping)))
+	{
+	    std::cerr << "Error: Cannot enable CAN timestamping" << std::endl;
+	    exit(-9);
+	}
+
+	if (config.console.kernel_filter)
+	    install_can_filter();
+
+	bus_frames_at_start = busFrames();
+	io_engine = IoEngine::create(config.io_backend, can_socket, config.console.rx_batch_size, 1,
+				     std::chrono::microseconds(0));
+	if (!io_engine)
+	{
+	    std::cerr << "Error: Cannot set up CAN socket I/O" << std::endl;
+	    exit(-12);
+	}
+	if (config.io_backend != io_engine->name())
+	    std::cerr << "Message: " << config.io_backend << " I/O is not available, using " << io_engine->name() << std::endl;
+    }
+
+    void initialize_packet_ring(const char* name)
+    {
+	strcpy(ifr.ifr_name, name);
+	packet_ring = std::make_unique<PacketRing>();
+	if (!packet_ring->open(name, config.console.packet_block_size,
+			       config.console.packet_blocks,
+			       config.console.packet_block_timeout))
+	{
+	    std::cerr << "Error: Cannot set up packet capture ring on " << name << ": " << strerror(errno) << std::endl;
+	    exit(-11);
+	}
+	bus_frames_at_start = busFrames();
+    }
+
+    void initialize_messages()
+    {
+#ifdef SIMULATOR_BAKED_LAYOUT
+	if (randomize || seed)
+	{
+	    std::cerr << "Warning: the message layout is compiled in, it is not randomized" << std::endl;
+	    randomize = 0;
+	    seed = 0;
+	}
+#endif
 	if (randomize || seed)
 	{
 	    if (randomize)
 		seed = time(NULL);
 	    srand(seed);
 
-	    CanMessage::ID::Door = (rand() % 2046) + 1;
-	    CanMessage::ID::Signal = (rand() % 2046) + 1;
-	    CanMessage::ID::Speed = (rand() % 2046) + 1;
+	    config.messages.door.id = (rand() % 2046) + 1;
+	    config.messages.signal.id = (rand() % 2046) + 1;
+	    config.messages.speed.id = (rand() % 2046) + 1;
 
-	    CanMessage::Position::Door = rand() % 9;
-	    CanMessage::Position::Signal = rand() % 9;
-	    CanMessage::Position::Speed = rand() % 9;
+	    config.messages.door.position = rand() % 9;
+	    config.messages.signal.position = rand() % 9;
+	    config.messages.speed.position = rand() % 9;
 
 	    std::cout << "Randomizer seed: " << seed << std::endl;
 	}
+
+	if (!config.console.database.empty())
+	{
+	    if (!database.load(config.console.database))
+		exit(-13);
+	    for (const DbcMessage& message : database.messages())
+	    {
+		database_decoders.push_back(std::make_unique<DatabaseDecoder>(message));
+	    }
+	}
+
+	compile_plans();
+	build_dispatch_table();
+    }
+
+    void compile_plans()
+    {
+	door_plan = DecodePlan(vehicleMessage(config.messages.door, VehicleSignal::Door));
+	signal_plan = DecodePlan(vehicleMessage(config.messages.signal, VehicleSignal::TurnSignal));
+	speed_plan = DecodePlan(vehicleMessage(config.messages.speed, VehicleSignal::Speed));
+	diagnostic_plan = DecodePlan(vehicleMessage(config.messages.diagnostic, VehicleSignal::Diagnostic));
+    }
+
+    void add_can_filter(std::vector<can_filter>& filters, canid_t can_id)
+    {
+	can_filter filter;
+	filter.can_id = can_id;
+	if (filter.can_id & CAN_EFF_FLAG)
+	    filter.can_mask = CAN_EFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	else
+	    filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	filters.push_back(filter);
+    }
+
+    void add_handler(int id, Handler handler)
+    {
+	canid_t can_id = CanMessage::frameId(id);
+	Handler registered = dispatch_table.find(can_id);
+	if (!registered)
+	{
+	    dispatch_table.add(can_id, handler);
+	    return;
+	}
+
+	std::cerr << "Warning: CAN id " << id << " is used by more than one message, all of them decode it" << std::endl;
+	std::vector<Handler>& handlers = shared_handlers[can_id];
+	if (handlers.empty())
+	    handlers.push_back(registered);
+	handlers.push_back(handler);
+	dispatch_table.add(can_id, &Console::dispatchShared);
+    }
+
+    void dispatchShared(const ReceivedFrame& received)
+    {
+	for (Handler handler : shared_handlers.find(received.frame.can_id)->second)
+	{
+	    (this->*handler)(received);
+	}
+    }
+
+    void build_dispatch_table()
+    {
+	dispatch_table.clear();
+	shared_handlers.clear();
+	add_handler(config.messages.door.id, &Console::updateDoorStatus);
+	add_handler(config.messages.signal.id, &Console::updateSignalStatus);
+	add_handler(config.messages.speed.id, &Console::updateSpeedStatus);
+	add_handler(config.messages.diagnostic.id, &Console::updateDiagnosticStatus);
+
+	database_table.clear();
+	for (const auto& decoder : database_decoders)
+	{
+	    // the vehicle messages keep their ids
+	    if (dispatch_table.find(decoder->message->id))
+	    {
+		std::cerr << "Warning: DBC message " << decoder->message->name << " uses the id of another message, it is not decoded" << std::endl;
+		continue;
+	    }
+	    dispatch_table.add(decoder->message->id, &Console::updateDatabaseStatus);
+	    database_table.add(decoder->message->id, decoder.get());
+	}
+    }
+
+    // whether a frame with can_id passes every filter, as the kernel checks joined filters
+    static bool passes_joined_filters(const std::vector<can_filter>& filters, canid_t can_id)
+    {
+	for (const can_filter& filter : filters)
+	{
+	    bool match = (can_id & filter.can_mask) == (filter.can_id & ~CAN_INV_FILTER & filter.can_mask);
+	    if (match == !!(filter.can_id & CAN_INV_FILTER))
+		return false;
+	}
+	return true;
+    }
+
+    void install_can_filter()
+    {
+	/*
+	   Only the configured messages reach this socket, everything else is dropped by the
+	   kernel before it is queued. Joined filters are AND-ed, which would never match with
+	   several exact ids, so in that mode only the extra filters from the configuration are used.
+	*/
+	std::vector<can_filter> filters;
+	int join_filters = config.console.join_filters && !config.console.filters.empty();
+
+	if (!join_filters)
+	{
+	    add_can_filter(filters, CanMessage::frameId(config.messages.door.id));
+	    add_can_filter(filters, CanMessage::frameId(config.messages.signal.id));
+	    add_can_filter(filters, CanMessage::frameId(config.messages.speed.id));
+	    add_can_filter(filters, CanMessage::frameId(config.messages.diagnostic.id));
+	    for (const auto& decoder : database_decoders)
+	    {
+		add_can_filter(filters, decoder->message->id);
+	    }
+	}
+	for (const FilterMask& mask : config.console.filters)
+	{
+	    filters.push_back({ mask.id, mask.mask });
+	}
+	if (join_filters)
+	{
+	    const std::pair<const char *, int> vehicle[] = {
+		{ "door", config.messages.door.id },
+		{ "signal", config.messages.signal.id },
+		{ "speed", config.messages.speed.id },
+		{ "diagnostic", config.messages.diagnostic.id }
+	    };
+	    for (const auto& [name, id] : vehicle)
+	    {
+		if (!passes_joined_filters(filters, CanMessage::frameId(id)))
+		    std::cerr << "Warning: the joined CAN filters drop the " << name << " message (id " << id << ")" << std::endl;
+	    }
+	}
+
+	// CAN_RAW_FILTER_MAX of the kernel, which is not exported to user space
+	if (filters.size() > 512)
+	{
+	    std::cerr << "Warning: " << filters.size() << " CAN filters exceed the kernel limit of 512, receiving every frame" << std::endl;
+	    return;
+	}
+	if (setsockopt(can_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter)))
+	{
+	    std::cerr << "Error: Cannot install CAN filter" << std::endl;
+	    exit(-8);
+	}
+	if (join_filters && setsockopt(can_socket, SOL_CAN_RAW, CAN_RAW_JOIN_FILTERS, &join_filters, sizeof(join_filters)))
+	{
+	    std::cerr << "Error: Cannot join CAN filters" << std::endl;
+	    exit(-8);
+	}
+    }
+
+    // frames seen on the interface, as counted by the network device
+    unsigned long long busFrames()
+    {
+	std::ifstream counter(std::string("/sys/class/net/") + ifr.ifr_name + "/statistics/rx_packets");
+	unsigned long long frames = 0;
+	counter >> frames;
+	return frames;
     }
 public:
-    Console()
+    explicit Console(const SimulationConfig& configuration)
+	: config(configuration)
     {
 	current_speed = 0;
-	maxdlen = 0;
+	state_version = 0;
 	randomize = 0;
 	seed = 0;
+	kernel_drops = 0;
+	id_frames.assign(CAN_SFF_MASK + 1, 0);
+	fd_frames = 0;
+	payload_bytes = 0;
+	if (!config.console.metrics_file.empty())
+	    metrics = std::make_unique<MetricsFile>(config.console.metrics_file);
+	backpressure_stalls = 0;
+	ring_overflows = 0;
+	last_report_time = std::chrono::steady_clock::now();
 
 	for (int i = 0; i < 4; ++i)
 	{
-	    door_status[i] = Car::Status::Door::Locked;
+	    door_status[i] = config.car.door_locked;
 	}
 
 	for (int i = 0; i < 2; ++i)
 	{
-	    turn_status[i] = Car::Status::TurnSignal::Off;
+	    turn_status[i] = config.car.turn_signal_off;
 	}
 
-	initialize_can_socket("vcan0");
+	initialize_messages();
+	if (config.console.capture == "mmap")
+	    initialize_packet_ring("vcan0");
+	else
+	    initialize_can_socket("vcan0");
     }
 
     long map(long x, long in_min, long in_max, long out_min, long out_max)
@@ -128,172 +440,469 @@ public:
 	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
     }
 
-    void updateDoors() 
+    void renderDoors(std::ostream& out)
     {
 	// No update if all doors are locked
-	if (door_status[0] == Car::Status::Door::Locked && 
-	    door_status[1] == Car::Status::Door::Locked &&
-	    door_status[2] == Car::Status::Door::Locked && 
-	    door_status[3] == Car::Status::Door::Locked) 
+	if (door_status[0] == config.car.door_locked && 
+	    door_status[1] == config.car.door_locked &&
+	    door_status[2] == config.car.door_locked && 
+	    door_status[3] == config.car.door_locked) 
 	    return;
 
 	// Make the base body red if even one door is unlocked
-	if(door_status[0] == Car::Status::Door::Unlocked)
+	if(door_status[0] == config.car.door_unlocked)
 	{
-	    std::cout << "Door 1 is UNLOCKED" << std::endl;;
+	    out << "Door 1 is UNLOCKED\n";
 	}
-	if(door_status[1] == Car::Status::Door::Unlocked) 
+	if(door_status[1] == config.car.door_unlocked) 
 	{
-	    std::cout << "Door 2 is UNLOCKED" << std::endl;
+	    out << "Door 2 is UNLOCKED\n";
 	}
-	if(door_status[2] == Car::Status::Door::Unlocked) 
+	if(door_status[2] == config.car.door_unlocked) 
 	{
-	    std::cout << "Door 3 is UNLOCKED" << std::endl;
+	    out << "Door 3 is UNLOCKED\n";
 	}
-	if(door_status[3] == Car::Status::Door::Unlocked) 
+	if(door_status[3] == config.car.door_unlocked) 
 	{
-	    std::cout << "Door 4 is UNLOCKED" << std::endl;
+	    out << "Door 4 is UNLOCKED\n";
 	}
     }
 
-    void updateSpeed()
+    void renderSpeed(std::ostream& out)
     {
-	std::cout << "Current speed: " << current_speed << std::endl;
+	out << "Current speed: " << current_speed << "\n";
     }
 
-    void updateTurnSignals()
+    void renderTurnSignals(std::ostream& out)
     {
-	if (turn_status[0] == Car::Status::TurnSignal::Off)
+	if (turn_status[0] == config.car.turn_signal_off)
+	{
+	    out << "Turn signal 1 is OFF\n";
+	}
+	if (turn_status[1] == config.car.turn_signal_off)
 	{
-	    std::cout << "Turn signal 1 is OFF" << std::endl;
+	    out << "Turn signal 2 is OFF\n";
 	}
-	if (turn_status[1] == Car::Status::TurnSignal::Off)
+	if (turn_status[0] == config.car.turn_signal_on)
 	{
-	    std::cout << "Turn signal 2 is OFF" << std::endl;
+	    out << "Turn signal 1 is ON\n";
 	}
-	if (turn_status[0] == Car::Status::TurnSignal::On)
+	if (turn_status[1] == config.car.turn_signal_on)
 	{
-	    std::cout << "Turn signal 1 is ON" << std::endl;
+	    out << "Turn signal 2 is ON\n";
 	}
-	if (turn_status[1] == Car::Status::TurnSignal::On)
+    }
+
+    [[noreturn]] void renderDashboard()
+    {
+	std::chrono::nanoseconds interval(1000000000LL / config.console.refresh_rate);
+	bool terminal = isatty(STDOUT_FILENO);
+	unsigned long rendered_version = 0;
+	auto next_frame = std::chrono::steady_clock::now();
+
+	while(true)
 	{
-	    std::cout << "Turn signal 2 is ON" << std::endl;
+	    next_frame += interval;
+	    auto now = std::chrono::steady_clock::now();
+	    if (next_frame < now)
+		next_frame = now;
+	    std::this_thread::sleep_until(next_frame);
+
+	    unsigned long version = state_version;
+	    if (version == rendered_version)
+		continue;
+	    rendered_version = version;
+
+	    // compose the whole dashboard first, so one redraw is one write
+	    std::ostringstream out;
+	    if (terminal)
+		out << "\033[H\033[2J";
+	    renderSpeed(out);
+	    renderTurnSignals(out);
+	    renderDoors(out);
+	    std::cout << out.str() << std::flush;
 	}
     }
 
-    void updateSpeedStatus()
+    void updateSpeedStatus(const ReceivedFrame& received)
     {
-	int len = can_frame.len > maxdlen ? maxdlen : can_frame.len;
-	if (len < CanMessage::Position::Speed + 1)
+#ifdef SIMULATOR_BAKED_LAYOUT
+	if (received.dataLength() < BakedLayout::Speed::Value::needed)
+	    return;
+	long long speed = BakedLayout::Speed::Value::decode(received.frame.data);
+#else
+	long long speed;
+	if (!speed_plan.decodeRaw(received.frame.data, received.dataLength(), &speed))
 	    return;
+#endif
 
-	int speed = can_frame.data[CanMessage::Position::Speed] << 8;
-	speed += can_frame.data[CanMessage::Position::Speed + 1];
-        speed = speed / 100; // speed in kilometers
-        current_speed = speed;
+	current_speed = speed / 100; // speed in kilometers
 
-	updateSpeed();
+	++state_version;
     }
 
-    void updateSignalStatus()
+    void updateSignalStatus(const ReceivedFrame& received)
     {
-	int len = can_frame.len > maxdlen ? maxdlen : can_frame.len;
-	if (len < CanMessage::Position::Signal)
+#ifdef SIMULATOR_BAKED_LAYOUT
+	if (received.dataLength() < BakedLayout::Signal::Value::needed)
+	    return;
+	long long state = BakedLayout::Signal::Value::decode(received.frame.data);
+#else
+	long long state;
+	if (!signal_plan.decodeRaw(received.frame.data, received.dataLength(), &state))
 	    return;
+#endif
 
-	if (can_frame.data[CanMessage::Position::Signal] & 1)
-	    turn_status[0] = Car::Status::TurnSignal::On;
-	else
-	    turn_status[0] = Car::Status::TurnSignal::Off;
+	for (int i = 0; i < 2; ++i)
+	{
+	    turn_status[i] = (state & (1 << i)) ? config.car.turn_signal_on : config.car.turn_signal_off;
+	}
 
-	if (can_frame.data[CanMessage::Position::Signal] & 2)
-	    turn_status[1] = Car::Status::TurnSignal::On;
-	else
-	    turn_status[1] = Car::Status::TurnSignal::Off;
+	++state_version;
+    }
 
-	updateTurnSignals();
+    void updateDoorStatus(const ReceivedFrame& received)
+    {
+#ifdef SIMULATOR_BAKED_LAYOUT
+	if (received.dataLength() < BakedLayout::Door::Value::needed)
+	    return;
+	long long state = BakedLayout::Door::Value::decode(received.frame.data);
+#else
+	long long state;
+	if (!door_plan.decodeRaw(received.frame.data, received.dataLength(), &state))
+	    return;
+#endif
+
+	for (int i = 0; i < 4; ++i)
+	{
+	    door_status[i] = (state & (1 << i)) ? config.car.door_locked : config.car.door_unlocked;
+	}
+
+	++state_version;
     }
 
-    void updateDoorStatus()
+    void updateDiagnosticStatus(const ReceivedFrame& received)
     {
-	int len = can_frame.len > maxdlen ? maxdlen : can_frame.len;
-	if (len < CanMessage::Position::Door)
+#ifdef SIMULATOR_BAKED_LAYOUT
+	if (received.dataLength() < BakedLayout::Diagnostic::Value::needed)
+	    return;
+	long long sent = BakedLayout::Diagnostic::Value::decode(received.frame.data);
+#else
+	long long sent;
+	if (!diagnostic_plan.decodeRaw(received.frame.data, received.dataLength(), &sent))
 	    return;
+#endif
 
-	if (can_frame.data[CanMessage::Position::Door] & 1)
-	    door_status[0] = Car::Status::Door::Locked;
-	else
-	    door_status[0] = Car::Status::Door::Unlocked;
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	long long decoded = now.tv_sec * 1000000000LL + now.tv_nsec;
 
-	if (can_frame.data[CanMessage::Position::Door] & 2)
-	    door_status[1] = Car::Status::Door::Locked;
-	else
-	    door_status[1] = Car::Status::Door::Unlocked;
-	
-	if (can_frame.data[CanMessage::Position::Door] & 4)
-	    door_status[2] = Car::Status::Door::Locked;
+	std::lock_guard<std::mutex> lock(latency_lock);
+	end_to_end_latency.record(decoded - sent);
+	if (received.timestamp.tv_sec)
+	{
+	    long long kernel = received.timestamp.tv_sec * 1000000000LL + received.timestamp.tv_nsec;
+	    wire_latency.record(kernel - sent);
+	    decode_latency.record(decoded - kernel);
+	}
+    }
+
+    void updateDatabaseStatus(const ReceivedFrame& received)
+    {
+	DatabaseDecoder *decoder = database_table.find(received.frame.can_id);
+	if (!decoder->layout.decode(received.frame.data, received.dataLength(), decoder->scratch.data()))
+	    return;
+
+	for (size_t i = 0; i < decoder->scratch.size(); ++i)
+	{
+	    decoder->values[i].store(decoder->scratch[i], std::memory_order_relaxed);
+	}
+	decoder->frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string formatId(canid_t can_id)
+    {
+	// candump style: three hex digits for standard ids, eight for extended ones
+	std::ostringstream id;
+	if (can_id & CAN_EFF_FLAG)
+	    id << std::hex << std::setw(8) << std::setfill('0') << (can_id & CAN_EFF_MASK);
 	else
-	    door_status[2] = Car::Status::Door::Unlocked;
-	
-	if (can_frame.data[CanMessage::Position::Door] & 8)
-	    door_status[3] = Car::Status::Door::Locked;
+	    id << std::hex << std::setw(3) << std::setfill('0') << (can_id & CAN_SFF_MASK);
+	return id.str();
+    }
+
+    std::vector<std::pair<canid_t, unsigned long long>> idFrames()
+    {
+	std::vector<std::pair<canid_t, unsigned long long>> frames;
+	for (canid_t id = 0; id <= CAN_SFF_MASK; ++id)
+	{
+	    if (id_frames[id])
+		frames.emplace_back(id, id_frames[id]);
+	}
+	for (const auto& frame : extended_id_frames)
+	{
+	    frames.push_back(frame);
+	}
+	return frames;
+    }
+
+    unsigned long long framesReceived() const
+    {
+	return packet_ring ? packet_ring->framesReceived() : io_engine->framesReceived();
+    }
+
+    unsigned long long receiveSyscalls() const
+    {
+	return packet_ring ? packet_ring->syscallCount() : io_engine->syscallCount();
+    }
+
+    void exportMetrics(unsigned long long bus_frames, const std::vector<std::pair<canid_t, unsigned long long>>& frames)
+    {
+	metrics->counter("canbus_console_frames_received_total", "Frames received by the console.", framesReceived());
+	metrics->counter("canbus_console_receive_syscalls_total", "Receive syscalls (recvmmsg(), io_uring_enter(), epoll_wait() or poll()) made by the console.", receiveSyscalls());
+	metrics->counter("canbus_console_kernel_drops_total", "Frames dropped because the socket receive queue or capture ring overflowed.", kernel_drops);
+	metrics->counter("canbus_console_fd_frames_received_total", "CAN FD frames received by the console.", fd_frames);
+	metrics->counter("canbus_console_payload_bytes_received_total", "Payload bytes of the frames received by the console.", payload_bytes);
+	metrics->counter("canbus_bus_frames_total", "Frames counted on the CAN interface since the console started.", bus_frames);
+	metrics->counter("canbus_console_backpressure_stalls_total", "Times the receive thread waited for a full decoder ring.", backpressure_stalls);
+	metrics->counter("canbus_console_ring_overflows_total", "Frames dropped because a decoder ring stayed full.", ring_overflows);
+	for (const auto& frame : frames)
+	{
+	    metrics->counter("canbus_console_id_frames_received_total", "Frames received by the console per CAN id.",
+			     frame.second, "id=\"" + formatId(frame.first) + "\"");
+	}
+	for (const auto& decoder : database_decoders)
+	{
+	    metrics->counter("canbus_console_dbc_frames_decoded_total", "Frames of DBC messages decoded by the console.",
+			     decoder->frames.load(std::memory_order_relaxed), "message=\"" + decoder->message->name + "\"");
+	}
+	for (const auto& decoder : database_decoders)
+	{
+	    for (size_t i = 0; i < decoder->message->signals.size(); ++i)
+	    {
+		metrics->gauge("canbus_console_dbc_signal_value", "Latest physical value of every DBC signal.",
+			       decoder->values[i].load(std::memory_order_relaxed),
+			       "message=\"" + decoder->message->name + "\",signal=\"" + decoder->message->signals[i].name + "\"");
+	    }
+	}
+	if (!metrics->commit())
+	    std::cerr << "Warning: cannot write metrics to " << config.console.metrics_file << std::endl;
+    }
+
+    void reportStatistics()
+    {
+	if (config.statistics_interval <= 0)
+	    return;
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - last_report_time < std::chrono::milliseconds(config.statistics_interval))
+	    return;
+
+	std::cerr << "RX (" << (packet_ring ? "mmap" : io_engine->name()) << "): " << framesReceived() << " frames in "
+		  << receiveSyscalls() << " syscalls ("
+		  << (receiveSyscalls() ? (double)framesReceived() / receiveSyscalls() : 0.0) << " frames/syscall)";
+	if (packet_ring)
+	    std::cerr << ", " << packet_ring->blockCount() << " ring blocks";
+	std::cerr << std::endl;
+
+	unsigned long long bus_frames = busFrames() - bus_frames_at_start;
+	std::cerr << "Bus: " << bus_frames << " frames on " << ifr.ifr_name << ", "
+		  << framesReceived() << " received ("
+		  << (bus_frames ? 100.0 * framesReceived() / bus_frames : 0.0) << "%), "
+		  << kernel_drops << " dropped by the kernel" << std::endl;
+	std::cerr << "Frames: " << framesReceived() - fd_frames << " classic, " << fd_frames << " CAN FD, "
+		  << payload_bytes << " payload bytes" << std::endl;
+
+	std::vector<std::pair<canid_t, unsigned long long>> busiest = idFrames();
+	std::sort(busiest.begin(), busiest.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+	std::cerr << "Frames per id:";
+	for (size_t i = 0; i < busiest.size() && i < 8; ++i)
+	{
+	    std::cerr << " " << formatId(busiest[i].first) << "=" << busiest[i].second;
+	}
+	if (busiest.size() > 8)
+	    std::cerr << " (" << busiest.size() - 8 << " more ids)";
+	std::cerr << std::endl;
+
+	if (!database_decoders.empty())
+	{
+	    unsigned long long decoded = 0;
+	    size_t multiplexed = 0;
+	    for (const auto& decoder : database_decoders)
+	    {
+		decoded += decoder->frames.load(std::memory_order_relaxed);
+		multiplexed += decoder->layout.isMultiplexed();
+	    }
+	    std::cerr << "DBC: " << database_decoders.size() << " messages (" << multiplexed << " multiplexed) from "
+		      << config.console.database << ", " << decoded << " frames decoded" << std::endl;
+	}
+
+	if (!decoders.empty())
+	{
+	    size_t high_watermark = 0;
+	    for (const auto& decoder : decoders)
+	    {
+		if (decoder->ring.highWatermark() > high_watermark)
+		    high_watermark = decoder->ring.highWatermark();
+	    }
+	    std::cerr << "Decoders: " << decoders.size() << " threads, ring high watermark "
+		      << high_watermark << "/" << decoders[0]->ring.capacity() << ", "
+		      << backpressure_stalls << " backpressure stalls, "
+		      << ring_overflows << " ring overflows" << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(latency_lock);
+	if (end_to_end_latency.count())
+	{
+	    wire_latency.print(std::cerr, "Latency write -> kernel rx", 1000.0, "us");
+	    decode_latency.print(std::cerr, "Latency kernel rx -> decode", 1000.0, "us");
+	    end_to_end_latency.print(std::cerr, "Latency write -> decode", 1000.0, "us");
+	}
+
+	if (metrics)
+	    exportMetrics(bus_frames, busiest);
+	last_report_time = now;
+    }
+
+    void decodeFrame(const ReceivedFrame& received)
+    {
+	auto handler = dispatch_table.find(received.frame.can_id);
+	if (handler)
+	    (this->*handler)(received);
+    }
+
+    [[noreturn]] void decoderLoop(Decoder& decoder)
+    {
+	ReceivedFrame received;
+	unsigned idle = 0;
+
+	while(true)
+	{
+	    if (decoder.ring.pop(received))
+	    {
+		decodeFrame(received);
+		decoder.decoded.fetch_add(1, std::memory_order_relaxed);
+		idle = 0;
+		continue;
+	    }
+
+	    // stay responsive for a while after the last frame, then stop burning the CPU
+	    if (++idle < 256)
+		std::this_thread::yield();
+	    else
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+    }
+
+    void processFrame(const ReceivedFrame& received)
+    {
+	const canfd_frame& can_frame = received.frame;
+	if (received.length != CAN_MTU && received.length != CANFD_MTU)
+	{
+	    std::cerr << "Error: incompatible CAN frame." << std::endl;
+	    exit(-7);
+	}
+
+	if (received.length == CANFD_MTU)
+	    ++fd_frames;
+	payload_bytes += received.dataLength();
+
+	if (!(can_frame.can_id & ~CAN_SFF_MASK))
+	    ++id_frames[can_frame.can_id];
 	else
-	    door_status[3] = Car::Status::Door::Unlocked;
+	    ++extended_id_frames[can_frame.can_id];
+
+	if (decoders.empty())
+	{
+	    decodeFrame(received);
+	    return;
+	}
 
-	updateDoors();
+	Decoder& decoder = *decoders[can_frame.can_id % decoders.size()];
+	if (decoder.ring.push(received))
+	    return;
+
+	++backpressure_stalls;
+	auto deadline = std::chrono::steady_clock::now() +
+	    std::chrono::microseconds(config.console.backpressure_timeout);
+	while (!decoder.ring.push(received))
+	{
+	    if (std::chrono::steady_clock::now() >= deadline)
+	    {
+		++ring_overflows;
+		return;
+	    }
+	    std::this_thread::yield();
+	}
     }
 
-    [[noreturn]] void run()
+    // Source is IoEngine or PacketRing, both hand out frames in batches the same way
+    template <typename Source>
+    [[noreturn]] void receiveLoop(Source& source)
     {
 	while(true)
 	{
-	    int nbytes = recvmsg(can_socket, &msg, 0);
-	    if (nbytes < 0)
+	    // pull everything the kernel has queued (up to the batch or block size) at once
+	    int count = source.receive();
+	    if (count < 0)
 	    {
 		std::cerr << "Error: cannot read data from CAN fd" << std::endl;
 		exit(-6);
 	    }
 
-	    if ((size_t)nbytes == CAN_MTU)
-		maxdlen = CAN_MAX_DLEN;
-	    else if ((size_t)nbytes == CANFD_MTU)
-		maxdlen = CANFD_MAX_DLEN;
-	    else
+	    // both sources report a running drop count
+	    if (source.kernelDrops() != kernel_drops)
 	    {
-		std::cerr << "Error: incompatible CAN frame." << std::endl;
-		exit(-7);
+		std::cerr << "Message: " << source.kernelDrops() - kernel_drops << " CAN packets dropped ("
+			  << source.kernelDrops() << " in total)" << std::endl;
+		kernel_drops = source.kernelDrops();
 	    }
 
-	    for (cmsg = CMSG_FIRSTHDR(&msg);
-		    cmsg && (cmsg->cmsg_level == SOL_SOCKET);
-		    cmsg = CMSG_NXTHDR(&msg,cmsg))
+	    for (int i = 0; i < count; ++i)
 	    {
-		if (cmsg->cmsg_type == SO_TIMESTAMP)
-		    tv = *(struct timeval *)CMSG_DATA(cmsg);
-		else if (cmsg->cmsg_type == SO_RXQ_OVFL)
-		    std::cerr << "Message: CAN packet dropped" << std::endl;
+		processFrame(source.received(i));
 	    }
 
-	    if (can_frame.can_id == CanMessage::ID::Door)
-		updateDoorStatus();
-	    if (can_frame.can_id == CanMessage::ID::Signal)
-		updateSignalStatus();
-	    if (can_frame.can_id == CanMessage::ID::Speed)
-		updateSpeedStatus();
+	    reportStatistics();
 	}
     }
+
+    [[noreturn]] void run()
+    {
+	if (config.console.refresh_rate > 0)
+	    std::thread(&Console::renderDashboard, this).detach();
+
+	for (int i = 0; i < config.console.decoder_threads; ++i)
+	{
+	    decoders.push_back(std::make_unique<Decoder>(config.console.ring_size));
+	}
+	for (auto& decoder : decoders)
+	{
+	    std::thread(&Console::decoderLoop, this, std::ref(*decoder)).detach();
+	}
+
+	if (packet_ring)
+	    receiveLoop(*packet_ring);
+	else
+	    receiveLoop(*io_engine);
+    }
 };
 
 int main()
 {
     ConfigurationParser parser("./config.json");
-    if (!parser.parse())
+    std::optional<SimulationConfig> config = parser.parse();
+    if (!config)
     {
 	std::cerr << "Error: could not parse configuration file." << std::endl;
 	return -100;
     }
+#ifdef SIMULATOR_BAKED_LAYOUT
+    // the layout compiled in wins over the one configured at run time
+    config = BakedLayout::apply(*config);
+#endif
 
-    Console car_console;
+    Console car_console(*config);
     car_console.run();
     return 0;
 }
@@ -3,11 +3,17 @@
    Copyright(c) 2023 Adhokshaj Mishra <me@adhokshajmishraonline.in>
 */
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
 #include <thread>
 
 #include <linux/can.h>
@@ -20,14 +26,27 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include "../common/BusTiming.hpp"
 #include "../common/can.hpp"
-#include "../common/car.hpp"
 #include "../common/ConfigurationParser.hpp"
+#include "../common/CyclicScheduler.hpp"
+#include "../common/FrameEncoder.hpp"
+#include "../common/IoEngine.hpp"
+#include "../common/NoisePool.hpp"
+#include "../common/SimulationConfig.hpp"
+#include "../common/TrafficGenerator.hpp"
+#include "../common/TxQueue.hpp"
+#include "../common/VehicleMessage.hpp"
+
+#ifdef SIMULATOR_BAKED_LAYOUT
+#include "BakedLayout.hpp"
+#endif
 
 class Controller
 {
 private:
-    unsigned long long startup_time, current_time, last_acceleration_time, last_signal_time;
+    // this vehicle's own copy, nothing else writes to it
+    const SimulationConfig config;
     int difficulty;
 
     char door_state;
@@ -41,10 +60,27 @@ private:
     sockaddr_can addr;
     ifreq ifr;
     canfd_frame can_frame;
+    FrameEncoder door_encoder;
+    FrameEncoder signal_encoder;
+    FrameEncoder speed_encoder;
+    FrameEncoder diagnostic_encoder;
+    std::vector<FrameEncoder> periodic_encoders;
+    // one noise stream per message, so adding a message does not change the others
+    enum NoiseStream { DoorNoise, SignalNoise, SpeedNoise, PeriodicNoise };
+    std::vector<NoiseGenerator> noise;
+    // those streams generated ahead of time, from difficulty 2 on unless noise_blocks is 0
+    std::unique_ptr<NoisePool> noise_pool;
+
+    std::unique_ptr<IoEngine> io_engine;
+    TxQueue tx_queue;
+    std::unique_ptr<BusPacer> bus_pacer;
+    CyclicScheduler scheduler;
+    std::chrono::steady_clock::time_point last_report_time;
 protected:
     void initialize_can_socket(const char* name)
     {
-	if ((can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0)
+	// a full kernel queue must not stall the schedule, frames wait in tx_queue instead
+	if ((can_socket = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW)) < 0)
 	{
 	    std::cerr << "Error: Cannot initiliaze raw CAN socket" << std::endl;
 	    exit(-1);
@@ -73,19 +109,52 @@ protected:
 	}
     }
 
-    unsigned long long getTicks()
+    static TxQueue::Overflow overflow_policy(const std::string& name)
     {
-	clock_t now = clock();
-	return (unsigned long long)(now - startup_time);
+	TxQueue::Overflow policy = TxQueue::Overflow::DropOldest;
+	TxQueue::parsePolicy(name, policy);
+	return policy;
+    }
+
+    void scheduleMessages()
+    {
+	scheduler.add("door", std::chrono::milliseconds(config.messages.door.period),
+		      std::chrono::milliseconds(config.messages.door.offset),
+		      [this]() { unlockDoor(config.equipment.door2); });
+	scheduler.add("speed", std::chrono::milliseconds(config.messages.speed.period),
+		      std::chrono::milliseconds(config.messages.speed.offset),
+		      [this]() { checkAcceleration(); });
+	scheduler.add("signal", std::chrono::milliseconds(config.messages.signal.period),
+		      std::chrono::milliseconds(config.messages.signal.offset),
+		      [this]() { checkTurnSignal(); });
+	if (config.messages.diagnostic.period > 0)
+	{
+	    scheduler.add("diagnostic", std::chrono::milliseconds(config.messages.diagnostic.period),
+			  std::chrono::milliseconds(config.messages.diagnostic.offset),
+			  [this]() { sendDiagnostic(); });
+	}
+
+	for (size_t i = 0; i < config.messages.periodic.size(); ++i)
+	{
+	    const PeriodicFrame& frame = config.messages.periodic[i];
+	    if (!frame.period)
+	    {
+		// a frame without a period is sent once, offset after the start
+		scheduler.once(std::chrono::milliseconds(frame.offset), [this, i]() { sendPeriodicFrame(i); });
+		continue;
+	    }
+	    scheduler.add(std::to_string(frame.id), std::chrono::milliseconds(frame.period),
+			  std::chrono::milliseconds(frame.offset),
+			  [this, i]() { sendPeriodicFrame(i); });
+	}
     }
 public:
-    Controller()
+    explicit Controller(const SimulationConfig& configuration)
+	: config(configuration),
+	  tx_queue(config.controller.tx_queue_size, overflow_policy(config.controller.tx_overflow)),
+	  scheduler(std::chrono::microseconds(config.controller.tick_resolution))
     {
-	//initialize the clock time
-	startup_time = clock();
-	current_time = startup_time;
-	last_acceleration_time = startup_time;
-	last_signal_time = startup_time;
+	difficulty = config.controller.difficulty;
 
 	//initialize vehicle state
 	door_state = 0xf;
@@ -97,171 +166,442 @@ public:
 	enable_canfd = 1;
 
 	initialize_can_socket("vcan0");
+
+	io_engine = IoEngine::create(config.io_backend, can_socket, 1, config.controller.tx_batch_size,
+				     std::chrono::microseconds(config.controller.tx_flush_deadline));
+	if (!io_engine)
+	{
+	    std::cerr << "Error: Cannot set up CAN socket I/O" << std::endl;
+	    exit(-6);
+	}
+	if (config.io_backend != io_engine->name())
+	    std::cerr << "Message: " << config.io_backend << " I/O is not available, using " << io_engine->name() << std::endl;
+	if (config.controller.bitrate > 0)
+	{
+	    BusTiming::Stuffing stuffing = BusTiming::Stuffing::Exact;
+	    BusTiming::parseStuffing(config.controller.bit_stuffing, stuffing);
+	    bus_pacer = std::make_unique<BusPacer>(BusTiming(config.controller.bitrate,
+							      config.controller.data_bitrate, stuffing));
+	}
+	last_report_time = std::chrono::steady_clock::now();
+
+	compileEncoders();
+	seedNoise();
+	scheduleMessages();
     }
 
     void sendPacket(int mtu)
     {
-	if (write(can_socket, &can_frame, mtu) != mtu)
+	// frames are only queued here, the tick's frames go out in arbitration order when it ends
+	if (!tx_queue.push(can_frame, mtu))
+	{
+	    while (tx_queue.full())
+	    {
+		io_engine->waitWritable(std::chrono::milliseconds(1));
+		drainPackets();
+	    }
+	    tx_queue.push(can_frame, mtu);
+	}
+    }
+
+    void drainPackets()
+    {
+	if (tx_queue.drain(*io_engine, bus_pacer.get()) < 0)
 	{
 	    std::cerr << "Error: Cannot write complate CAN frame" << std::endl;
 	    exit(-2);
 	}
     }
 
-    void randomizePacket(int start, int stop)
+    void flushPackets()
+    {
+	drainPackets();
+
+	// keep draining until everything is out or the next release is due
+	while (io_engine->pending() || !tx_queue.empty())
+	{
+	    long long now = CyclicScheduler::now();
+	    long long release = scheduler.nextRelease();
+	    if (release <= now)
+		break;
+
+	    if (bus_pacer && !bus_pacer->ready())
+	    {
+		// the simulated bus is still busy with the previous frame
+		long long idle = std::min(bus_pacer->idleAt(), release);
+		timespec deadline = { (time_t)(idle / 1000000000LL), (long)(idle % 1000000000LL) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+	    }
+	    else
+	    {
+		io_engine->waitWritable(std::min(std::chrono::microseconds((release - now) / 1000 + 1), std::chrono::microseconds(1000)));
+	    }
+	    drainPackets();
+	}
+    }
+
+    void reportStatistics()
+    {
+	if (config.statistics_interval <= 0)
+	    return;
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - last_report_time < std::chrono::milliseconds(config.statistics_interval))
+	    return;
+
+	unsigned long long syscalls = io_engine->syscallCount();
+	std::cerr << "TX (" << io_engine->name() << "): " << io_engine->framesSent() << " frames in "
+		  << syscalls << " syscalls ("
+		  << (syscalls ? (double)io_engine->framesSent() / syscalls : 0.0) << " frames/syscall)" << std::endl;
+	tx_queue.printStatistics(std::cerr);
+	if (bus_pacer)
+	    bus_pacer->printStatistics(std::cerr);
+	if (noise_pool)
+	    noise_pool->printStatistics(std::cerr);
+	scheduler.printStatistics(std::cerr);
+	last_report_time = now;
+    }
+
+    /*
+       the field of the signal in the common vehicle message layout. The bytes around the first
+       byte of the signal are filler, randomized when the difficulty asks for it, the diagnostic
+       time stamp fills its payload
+    */
+    FrameEncoder compileEncoder(const MessageLayout& layout, VehicleSignal kind) const
+    {
+	DbcMessage message = vehicleMessage(layout, kind);
+	const DbcSignal& signal = message.signals[0];
+	int position = signal.start_bit / 8;
+	FrameEncoder encoder(message.id, message.length, layout.fd, config.messages.brs, config.messages.esi);
+	encoder.addField(position, signal.length / 8, signal.big_endian);
+	if (kind != VehicleSignal::Diagnostic)
+	{
+	    encoder.addFiller(0, position);
+	    encoder.addFiller(position + 1, encoder.length());
+	}
+	return encoder;
+    }
+
+    // lay out every message once, sending is then a template copy plus the signal stores
+    void compileEncoders()
+    {
+	door_encoder = compileEncoder(config.messages.door, VehicleSignal::Door);
+	signal_encoder = compileEncoder(config.messages.signal, VehicleSignal::TurnSignal);
+	speed_encoder = compileEncoder(config.messages.speed, VehicleSignal::Speed);
+	diagnostic_encoder = compileEncoder(config.messages.diagnostic, VehicleSignal::Diagnostic);
+
+	periodic_encoders.clear();
+	for (const PeriodicFrame& frame : config.messages.periodic)
+	{
+	    FrameEncoder encoder(CanMessage::frameId(frame.id), frame.length, frame.fd, frame.brs, config.messages.esi);
+	    encoder.setData(frame.data);
+	    encoder.addFiller(0, encoder.length());
+	    periodic_encoders.push_back(encoder);
+	}
+    }
+
+    void seedNoise()
+    {
+	noise.clear();
+	for (size_t stream = 0; stream < PeriodicNoise + periodic_encoders.size(); ++stream)
+	{
+	    noise.emplace_back(config.controller.seed, difficulty, stream);
+	}
+	if (difficulty >= 2 && config.controller.noise_blocks > 0)
+	    noise_pool = std::make_unique<NoisePool>(noise, config.controller.noise_block_size,
+						     config.controller.noise_blocks);
+    }
+
+    // 0 to 254, from the speed stream
+    int standstillNoise()
+    {
+	return noise_pool ? noise_pool->value(SpeedNoise) : noise[SpeedNoise].next() % 255;
+    }
+
+    void randomizeFiller(const FrameEncoder& encoder, size_t stream)
     {
 	if (difficulty < 2)
 	    return;
-	for (int i = start; i < stop; ++i)
+	for (const FrameEncoder::Span& span : encoder.fillers())
 	{
-	    if(rand() % 3 < 1)
-		can_frame.data[i] = rand() % 255;
+	    if (noise_pool)
+		noise_pool->scramble(stream, can_frame.data, span.start, span.stop);
+	    else
+		noise[stream].scramble(can_frame.data, span.start, span.stop);
 	}
     }
 
     void lockDoor(char door)
     {
 	door_state |= door;
-	memset(&can_frame, 0, sizeof(can_frame));
-	can_frame.can_id = CanMessage::ID::Door;
-	can_frame.len = CanMessage::Length::Door;
-	can_frame.data[CanMessage::Position::Door] = door_state;
-
-	if (CanMessage::Position::Door)
-	    randomizePacket(0, CanMessage::Position::Door);
-	if (CanMessage::Length::Door > CanMessage::Position::Door + 1)
-	    randomizePacket(CanMessage::Position::Door + 1, CanMessage::Length::Door);
-
-	sendPacket(CAN_MTU);
+	sendDoor();
     }
 
     void unlockDoor(char door)
     {
 	door_state &= ~door;
-	memset(&can_frame, 0, sizeof(can_frame));
-	can_frame.can_id = CanMessage::ID::Door;
-	can_frame.len = CanMessage::Length::Door;
-	can_frame.data[CanMessage::Position::Door] = door_state;
-
-	if (CanMessage::Position::Door)
-	    randomizePacket(0, CanMessage::Position::Door);
-	if (CanMessage::Length::Door > CanMessage::Position::Door + 1)
-	    randomizePacket(CanMessage::Position::Door + 1, CanMessage::Length::Door);
+	sendDoor();
+    }
 
-	sendPacket(CAN_MTU);
+    void sendDoor()
+    {
+#ifdef SIMULATOR_BAKED_LAYOUT
+	int mtu = door_encoder.copy(can_frame);
+	BakedLayout::Door::Value::encode(can_frame.data, (unsigned char)door_state);
+#else
+	int mtu = door_encoder.encode(can_frame, { (unsigned char)door_state });
+#endif
+	randomizeFiller(door_encoder, DoorNoise);
+	sendPacket(mtu);
     }
 
     void sendTurnSignal()
     {
-	memset(&can_frame, 0, sizeof(can_frame));
-	can_frame.can_id = CanMessage::ID::Signal;
-	can_frame.len = CanMessage::Length::Signal;
-	can_frame.data[CanMessage::Position::Signal] = signal_state;
-
-	if (CanMessage::Position::Signal)
-	    randomizePacket(0, CanMessage::Position::Signal);
-	if (CanMessage::Length::Signal > CanMessage::Position::Signal + 1)
-	    randomizePacket(CanMessage::Position::Signal + 1, CanMessage::Length::Signal);
-
-	sendPacket(CAN_MTU);
+#ifdef SIMULATOR_BAKED_LAYOUT
+	int mtu = signal_encoder.copy(can_frame);
+	BakedLayout::Signal::Value::encode(can_frame.data, (unsigned char)signal_state);
+#else
+	int mtu = signal_encoder.encode(can_frame, { (unsigned char)signal_state });
+#endif
+	randomizeFiller(signal_encoder, SignalNoise);
+	sendPacket(mtu);
     }
 
     void sendSpeed()
     {
 	int kmph = current_speed * 100;
-	memset(&can_frame, 0, sizeof(can_frame));
-	can_frame.can_id = CanMessage::ID::Speed;
-	can_frame.len = CanMessage::Length::Speed;
+	// big endian, a standing car sends 0x01 and a random byte
+	unsigned long long speed = kmph ? kmph & 0xffff : 0x100 | ((standstillNoise() + 100) & 0xff);
 	
-	if (kmph)
-	{
-	    // we have to split the speed data, and set that in correct order
-	    can_frame.data[CanMessage::Position::Speed + 1] = (char)kmph & 0xff;
-	    can_frame.data[CanMessage::Position::Speed] = (char)(kmph >> 8) & 0xff;
-	}
-	else
-	{
-	    can_frame.data[CanMessage::Position::Speed] = 1;
-	    can_frame.data[CanMessage::Position::Speed + 1] = rand() % 255+100;
-	}
+#ifdef SIMULATOR_BAKED_LAYOUT
+	int mtu = speed_encoder.copy(can_frame);
+	BakedLayout::Speed::Value::encode(can_frame.data, speed);
+#else
+	int mtu = speed_encoder.encode(can_frame, { speed });
+#endif
+	randomizeFiller(speed_encoder, SpeedNoise);
+	sendPacket(mtu);
+    }
 
-	if (CanMessage::Position::Speed)
-	    randomizePacket(0, CanMessage::Position::Speed);
-	if (CanMessage::Length::Speed > CanMessage::Position::Speed + 1)
-	    randomizePacket(CanMessage::Position::Speed + 1, CanMessage::Length::Speed);
+    void sendDiagnostic()
+    {
+	// transmit time in CLOCK_REALTIME nanoseconds, the clock the kernel uses for RX timestamps
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	unsigned long long stamp = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+#ifdef SIMULATOR_BAKED_LAYOUT
+	int mtu = diagnostic_encoder.copy(can_frame);
+	BakedLayout::Diagnostic::Value::encode(can_frame.data, stamp);
+	sendPacket(mtu);
+#else
+	sendPacket(diagnostic_encoder.encode(can_frame, { stamp }));
+#endif
+    }
 
-	sendPacket(CAN_MTU);
+    void sendPeriodicFrame(size_t index)
+    {
+	const FrameEncoder& encoder = periodic_encoders[index];
+	int mtu = encoder.encode(can_frame, {});
+	randomizeFiller(encoder, PeriodicNoise + index);
+	sendPacket(mtu);
     }
 
     void checkAcceleration()
     {
-	float rate = CarParameters::MaximumSpeed / (CarParameters::AccelerationRate * 100);
+	// called once per speed period, the speed changes by the amount gained in that period
+	float rate = config.car.maximum_speed / config.car.acceleration_rate * config.messages.speed.period / 1000;
 
-	// refresh at every 10ms
-	if (current_time > last_acceleration_time + 10)
+	if (throttle < 0)
 	{
-	    if (throttle < 0)
-	    {
-		current_speed -= rate;
-		if (current_speed < 1)
-		    current_speed = 0;
-	    }
-	    if (throttle > 0)
-	    {
-		current_speed += rate;
-		if (current_speed > CarParameters::MaximumSpeed)
-		    current_speed = CarParameters::MaximumSpeed;
-	    }
-
-	    sendSpeed();
-	    last_acceleration_time = current_time;
+	    current_speed -= rate;
+	    if (current_speed < 1)
+		current_speed = 0;
 	}
+	if (throttle > 0)
+	{
+	    current_speed += rate;
+	    if (current_speed > config.car.maximum_speed)
+		current_speed = config.car.maximum_speed;
+	}
+
+	sendSpeed();
     }
 
     void checkTurnSignal()
     {
-	// refresh every 500ms
-	if (current_time > last_signal_time + 500)
-	{
-	    if (turning < 0)
-		signal_state ^= CanMessage::Equipment::LeftSignal;
-	    else if (turning > 0)
-		signal_state ^= CanMessage::Equipment::RightSignal;
-	    else
-		signal_state = 0;
+	if (turning < 0)
+	    signal_state ^= config.equipment.left_signal;
+	else if (turning > 0)
+	    signal_state ^= config.equipment.right_signal;
+	else
+	    signal_state = 0;
 
-	    sendTurnSignal();
-	    last_signal_time = current_time;
-	}
+	sendTurnSignal();
     }
 
     [[noreturn]] void run()
     {
+	scheduler.start();
 	while(true)
 	{
-	    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
 	    throttle = 1;
 	    turning = 2;
 
-	    unlockDoor(CanMessage::Equipment::Door2);
-	    current_time = getTicks();
-	    checkAcceleration();
-	    checkTurnSignal();
+	    // sleeps until the next release on the absolute timeline, then sends every due message
+	    scheduler.runOnce();
+
+	    flushPackets();
+	    reportStatistics();
 	}
     }
+
+    /*
+       Load test mode: sends generated frames at the configured frames per second or
+       busload instead of the vehicle messages. Sending is credit based, the credit grows
+       at the rate a RateController commands, and every control interval the controller
+       compares the rate the kernel actually took with the target.
+    */
+    [[noreturn]] void runGenerator()
+    {
+	TrafficGenerator::Payload payload = TrafficGenerator::Payload::Random;
+	TrafficGenerator::parsePayload(config.generator.payload, payload);
+	TrafficGenerator generator(config.generator.ids, config.generator.min_length,
+				   config.generator.max_length, payload,
+				   config.generator.fd, config.generator.brs);
+
+	bool busload = config.generator.busload > 0;
+	bool unlimited = !busload && config.generator.fps <= 0;
+	if (busload && config.controller.bitrate <= 0)
+	{
+	    std::cerr << "Error: generator busload needs a controller bitrate" << std::endl;
+	    exit(-7);
+	}
+	BusTiming::Stuffing stuffing = BusTiming::Stuffing::Exact;
+	BusTiming::parseStuffing(config.controller.bit_stuffing, stuffing);
+	BusTiming timing(config.controller.bitrate, config.controller.data_bitrate, stuffing);
+
+	// frames per second, or nanoseconds of bus time per second
+	double target = busload ? config.generator.busload * 1e7 : config.generator.fps;
+	RateController rate(target);
+	const long long control_interval = 10000000;
+	const long long minimum_sleep = 100000;
+
+	int mtu = generator.next(can_frame);
+	double cost = busload ? timing.frameTime(can_frame, mtu) : 1.0;
+	double command = target;
+	double credit = 0;
+	bool saturated = false;
+	unsigned long long queued = 0;
+	double queued_cost = 0;
+
+	long long last_credit = CyclicScheduler::now();
+	long long last_control = last_credit;
+	long long last_report = last_credit;
+	unsigned long long control_sent = io_engine->framesSent();
+	unsigned long long report_sent = control_sent;
+	while (true)
+	{
+	    // hand out what the credit allows, one batch at a time
+	    int error = 0;
+	    for (int i = 0; i < config.controller.tx_batch_size && (unlimited || credit >= cost); ++i)
+	    {
+		if (!io_engine->queue(can_frame, mtu))
+		{
+		    error = errno;
+		    break;
+		}
+		credit -= cost;
+		++queued;
+		queued_cost += cost;
+		mtu = generator.next(can_frame);
+		if (busload)
+		    cost = timing.frameTime(can_frame, mtu);
+	    }
+	    if (!io_engine->flush() && !error)
+		error = errno;
+	    if (error && error != EAGAIN && error != EWOULDBLOCK && error != ENOBUFS)
+	    {
+		std::cerr << "Error: Cannot write complate CAN frame" << std::endl;
+		exit(-2);
+	    }
+	    bool refused = error != 0;
+	    saturated |= refused;
+
+	    long long now = CyclicScheduler::now();
+	    if (now - last_control >= control_interval)
+	    {
+		double dt = (now - last_control) / 1e9;
+		unsigned long long sent = io_engine->framesSent();
+		double achieved = (sent - control_sent) * (queued ? queued_cost / queued : cost) / dt;
+		command = rate.update(achieved, dt, saturated);
+		control_sent = sent;
+		last_control = now;
+		saturated = false;
+	    }
+	    if (now - last_report >= 1000000000LL)
+	    {
+		reportGenerator(now - last_report, io_engine->framesSent() - report_sent, queued ? queued_cost / queued : cost,
+				busload, unlimited);
+		report_sent = io_engine->framesSent();
+		last_report = now;
+		reportStatistics();
+	    }
+
+	    // a stall is made up for within one control interval, never with a longer burst
+	    credit += command * (now - last_credit) / 1e9;
+	    if (credit > command * control_interval / 1e9 + cost)
+		credit = command * control_interval / 1e9 + cost;
+	    last_credit = now;
+
+	    if (refused)
+	    {
+		io_engine->waitWritable(std::chrono::milliseconds(1));
+	    }
+	    else if (!unlimited && credit < cost)
+	    {
+		// sleeping at least minimum_sleep lets high rates go out in batches
+		long long sleep = command > 0 ? (long long)((cost - credit) / command * 1e9) : control_interval;
+		sleep = std::min(std::max(sleep, minimum_sleep), control_interval);
+		std::this_thread::sleep_for(std::chrono::nanoseconds(sleep));
+	    }
+	}
+    }
+
+    void reportGenerator(long long elapsed, unsigned long long frames, double average_cost, bool busload, bool unlimited)
+    {
+	double fps = frames * 1e9 / elapsed;
+	std::cerr << "Generator: requested ";
+	if (busload)
+	    std::cerr << config.generator.busload << " % busload";
+	else if (unlimited)
+	    std::cerr << "max";
+	else
+	    std::cerr << config.generator.fps << " fps";
+	std::cerr << ", achieved " << fps << " fps";
+	if (busload)
+	    std::cerr << " (" << fps * average_cost / 1e7 << " % busload)";
+	std::cerr << std::endl;
+    }
 };
 
 int main()
 {
     ConfigurationParser parser("./config.json");
-    if (!parser.parse())
+    std::optional<SimulationConfig> config = parser.parse();
+    if (!config)
     {
 	std::cerr << "Error: could not parse configuration file." << std::endl;
 	return -100;
     }
-
-    Controller ctl;
+#ifdef SIMULATOR_BAKED_LAYOUT
+    // the layout compiled in wins over the one configured at run time
+    config = BakedLayout::apply(*config);
+#endif
+
+    Controller ctl(*config);
+    if (config->generator.enabled)
+	ctl.runGenerator();
     ctl.run();
     return 0;
 }